@@ -1,201 +1,229 @@
+#include <cstring>
 #include "citizen.h"
 
 class Node;
-extern Line WALKING_LINE;
-
-std::mutex blockStack; // controls access to CitizenVector.inactive()
-std::mutex citizensMutex; // controls access to citizens.vec (used for debug reports, simulation, pushing back new citizens)
-
-#define MOVE if (moveDownPath()) return true
-#define DESPAWN status = STATUS_DESPAWNED; return true
-
-void Citizen::reset() {
-	status = STATUS_SPAWNED;
-	currentTrain = nullptr;
-	currentNode = path[0].node;
-	currentLine = path[0].line;
-	nextNode = path[1].node;
-	index = 0;
-	timer = 0;
-	dist = 0;
+
+TimerWheel citizenWheel; // wakes walking/transferring citizens when they are due
+
+#define DESPAWN c->status[i] = STATUS_DESPAWNED; return true
+
+static inline uint64_t freeLink(uint64_t tag, unsigned int id) {
+	return (tag << 32) | id;
 }
 
-std::string Citizen::currentPathStr() {
+std::string Citizen::currentPathStr() const {
+	const PathLeg& leg = currentLeg();
 	char sum[NODE_ID_SIZE * 2 + LINE_ID_SIZE * 2 + 16];
-	std::strcpy(sum, currentNode->id);
+	std::strcpy(sum, leg.board->id);
 	std::strcat(sum, ",");
-	std::strcat(sum, currentLine->id);
+	std::strcat(sum, leg.line->id);
 	std::strcat(sum, "->");
-	if (nextNode != nullptr) {
-		std::strcat(sum, nextNode->id);
+	std::strcat(sum, leg.alight->id);
+	return sum;
+}
+
+CitizenVector::CitizenVector(size_t reserve, size_t maxS) {
+	maxSize = maxS;
+	size_t maxChunks = (maxSize + CITIZEN_CHUNK_SIZE - 1) / CITIZEN_CHUNK_SIZE;
+	chunks = new std::atomic<CitizenChunk*>[maxChunks];
+	for (size_t i = 0; i < maxChunks; i++) {
+		chunks[i] = nullptr;
+	}
+	numChunks = 0;
+	used = 0;
+	freeCount = 0;
+	freeHead = freeLink(0, CITIZEN_NO_SLOT);
+	spawnHead = CITIZEN_NO_SLOT;
+	live = new unsigned int[maxSize];
+	numLive = 0;
+
+	// allocate the reserve up front so the first spawn waves don't have to
+	for (size_t id = 0; id < std::min(reserve, maxSize); id += CITIZEN_CHUNK_SIZE) {
+		ensureChunk((unsigned int)id);
+	}
+}
+
+CitizenVector::~CitizenVector() {
+	size_t maxChunks = (maxSize + CITIZEN_CHUNK_SIZE - 1) / CITIZEN_CHUNK_SIZE;
+	for (size_t i = 0; i < maxChunks; i++) {
+		delete chunks[i].load();
+	}
+	delete[] chunks;
+	delete[] live;
+}
+
+CitizenChunk* CitizenVector::ensureChunk(unsigned int id) {
+	std::atomic<CitizenChunk*>& slot = chunks[id >> CITIZEN_CHUNK_BITS];
+	CitizenChunk* c = slot.load(std::memory_order_acquire);
+	if (c != nullptr) {
+		return c;
+	}
+	// threads racing for the same chunk each build one, the losers throw theirs away
+	CitizenChunk* fresh = new CitizenChunk();
+	if (slot.compare_exchange_strong(c, fresh, std::memory_order_acq_rel)) {
+		numChunks++;
+		return fresh;
+	}
+	delete fresh;
+	return c;
+}
+
+unsigned int CitizenVector::allocate() {
+	// reuse despawned slots first
+	uint64_t head = freeHead.load(std::memory_order_acquire);
+	while ((unsigned int)head != CITIZEN_NO_SLOT) {
+		unsigned int id = (unsigned int)head;
+		unsigned int next = chunk(id)->next[id & CITIZEN_CHUNK_MASK].load(std::memory_order_relaxed);
+		if (freeHead.compare_exchange_weak(head, freeLink((head >> 32) + 1, next), std::memory_order_acq_rel)) {
+			freeCount--;
+			return id;
+		}
+	}
+
+	unsigned int id = used.load(std::memory_order_relaxed);
+	do {
+		if (id >= maxSize) {
+			return CITIZEN_NO_SLOT;
+		}
+	} while (!used.compare_exchange_weak(id, id + 1, std::memory_order_acq_rel));
+	ensureChunk(id);
+	return id;
+}
+
+void CitizenVector::release(unsigned int id) {
+	CitizenChunk* c = chunk(id);
+	unsigned int i = id & CITIZEN_CHUNK_MASK;
+	uint64_t head = freeHead.load(std::memory_order_acquire);
+	do {
+		c->next[i].store((unsigned int)head, std::memory_order_relaxed);
+	} while (!freeHead.compare_exchange_weak(head, freeLink((head >> 32) + 1, id), std::memory_order_acq_rel));
+	freeCount++;
+}
+
+void CitizenVector::despawn(unsigned int id) {
+	CitizenChunk* c = chunk(id);
+	unsigned int i = id & CITIZEN_CHUNK_MASK;
+	if (c->path[i] != NULL_PATH) {
+		paths.release(c->path[i]);
+		c->path[i] = NULL_PATH;
+	}
+	c->status[i] = STATUS_DESPAWNED;
+}
+
+void CitizenVector::compact(std::vector<unsigned int>& despawned) {
+	// spawned citizens first, anything despawned this batch was spawned before it
+	unsigned int id = spawnHead.exchange(CITIZEN_NO_SLOT, std::memory_order_acq_rel);
+	while (id != CITIZEN_NO_SLOT) {
+		CitizenChunk* c = chunk(id);
+		unsigned int i = id & CITIZEN_CHUNK_MASK;
+		c->livePos[i] = (unsigned int)numLive;
+		live[numLive++] = id;
+		id = c->next[i].load(std::memory_order_relaxed);
+	}
+
+	for (unsigned int dead : despawned) {
+		unsigned int pos = chunk(dead)->livePos[dead & CITIZEN_CHUNK_MASK];
+		unsigned int moved = live[--numLive];
+		live[pos] = moved;
+		chunk(moved)->livePos[moved & CITIZEN_CHUNK_MASK] = pos;
+		release(dead);
+	}
+	despawned.clear();
+}
+
+void CitizenVector::enterPlatform(unsigned int id) {
+	CitizenChunk* c = chunk(id);
+	unsigned int i = id & CITIZEN_CHUNK_MASK;
+	// wait on the platform until a train heading towards the leg's end picks us up
+	const PathLeg& leg = paths.legs(c->path[i])[c->index[i]];
+	platformQueue(leg.line, leg.boardInd, leg.direction()).push(PlatformRider{ id, leg.alightInd });
+	c->waitTick[i] = citizenWheel.now();
+}
+
+void CitizenVector::startLeg(unsigned int id, NodeArrivals& arrivals) {
+	CitizenChunk* c = chunk(id);
+	unsigned int i = id & CITIZEN_CHUNK_MASK;
+	const PathLeg& leg = paths.legs(c->path[i])[c->index[i]];
+	if (leg.line == &WALKING_LINE) {
+		c->status[i] = STATUS_WALK;
 	}
 	else {
-		std::strcat(sum, "NEXT_NODE_NULL");
+		c->status[i] = STATUS_TRANSFER;
+		arrivals.add(leg.board);
 	}
-	return sum;
 }
 
-// returns true if the citizen has been despawned/is despawned
-bool Citizen::updatePositionAlongPath() {
-	if (nextNode == nullptr) {
+bool CitizenVector::update(unsigned int id, NodeArrivals& arrivals) {
+	CitizenChunk* c = chunk(id);
+	unsigned int i = id & CITIZEN_CHUNK_MASK;
+	if (c->path[i] == NULL_PATH) {
 		#if CITIZEN_SPAWN_ERRORS == true
-		std::cout << "ERR: despawned NULLPATHREF_MISC citizen@" << int(index) << ": " << currentPathStr() << std::endl;
+		std::cout << "ERR: despawned NULLPATHREF_MISC citizen " << id << std::endl;
 		#endif
 		DESPAWN;
 	}
 
-	timer += CITIZEN_SPEED;
-
-	switch (status) {
+	switch (c->status[i]) {
 	case STATUS_DESPAWNED:
 		return true;
 
 	case STATUS_SPAWNED:
-		if (currentLine == &WALKING_LINE) {
-			return switch_WALK();
-		}
-		else {
-			switch_TRANSFER();
-		}
+		c->spawnTick[i] = citizenWheel.now();
+		startLeg(id, arrivals);
 		return false;
 
+	// woken once the walk is over, or the train stopped where the leg ends
 	case STATUS_WALK:
-		if (timer > dist) {
-			MOVE;
-			if (currentLine == &WALKING_LINE) {
-				return switch_WALK();
-			}
-			else {
-				switch_TRANSFER();
-			}
+	case STATUS_ALIGHTED:
+		c->timer[i] = 0;
+		if (++c->index[i] >= paths.size(c->path[i])) {
+			DESPAWN;
 		}
+		startLeg(id, arrivals);
 		return false;
 
+	// woken once the citizen has made it through the station, see enterPlatform()
 	case STATUS_TRANSFER:
-		if (timer > CITIZEN_TRANSFER_THRESH) {
-			timer = 0;
-			int currentInd, nextInd;
-			for (int i = 0; i < currentLine->size; i++) {
-				Node* n = currentLine->path[i];
-				if (n == currentNode) {
-					currentInd = i;
-				}
-				if (n == nextNode) {
-					nextInd = i;
-				}
-			}
-			statusForward = nextInd > currentInd ? STATUS_FORWARD : STATUS_BACKWARD;
-			if (currentInd == 0 || currentInd == currentLine->size - 1) statusForward = STATUS_AMBIVALENT;
-			status = STATUS_AT_STOP;
-		}
-		return false;
-
-	// this is slow! try not to spend too much time at a stop
-	case STATUS_AT_STOP:
-		for (int i = 0; currentNode != nullptr && i < currentNode->numTrains(); i++) { // I don't know why the nullptr check is necessary lmao
-			Train* t = currentNode->trains[i];
-			if (t != nullptr && t->line == currentLine && t->capacity < TRAIN_CAPACITY && (t->statusForward == statusForward || statusForward == STATUS_AMBIVALENT)) {
-				util::subCapacity(&currentNode->capacity);
-				// we could store the distance until reaching the target node on this line locally, to prevent pointer jumps, but this probably has no performance effect
-				status = STATUS_BOARDED;
-				currentTrain = t;
-				currentTrain->capacity++;
-				MOVE;
-			}
-		}
-		return false;
-
-	case STATUS_BOARDED:
-		if (currentTrain->status == STATUS_IN_TRANSIT) {
-			status = STATUS_IN_TRANSIT;
-		}
-		return false;
-
-	case STATUS_IN_TRANSIT:
-		if (currentTrain->status == STATUS_AT_STOP && currentTrain->getLastStop() == currentNode) {
-			util::subCapacity(&currentTrain->capacity);
-			MOVE;
-
-			currentTrain = nullptr;
-
-			if (currentLine == &WALKING_LINE) {
-				return switch_WALK();
-			}
-			else {
-				switch_TRANSFER();
-			}
-
-		}
+		c->timer[i] = 0;
+		c->status[i] = STATUS_AT_STOP;
 		return false;
 
+	// waiting and riding citizens are moved by trains
 	default:
-		return (status == STATUS_DESPAWNED);
-	}
-}
-
-bool Citizen::cull() {
-	if (timer > CITIZEN_DESPAWN_THRESH && status != STATUS_DESPAWNED) {
-		#if CITIZEN_SPAWN_ERRORS == true
-		std::cout << "ERR: despawned TIMEOUT citizen @" << int(index) << ": " << currentPathStr() << std::endl;
-		#endif
-		if (status == STATUS_IN_TRANSIT) {
-			util::subCapacity(&currentTrain->capacity);
-		}
-		if (status == STATUS_AT_STOP || status == STATUS_TRANSFER) {
-			util::subCapacity(&currentNode->capacity);
-		}
-		DESPAWN;
+		return false;
 	}
-	return false;
-}
-
-CitizenVector::CitizenVector(size_t reserve, size_t maxS) {
-	vec.reserve(reserve);
-	maxSize = maxS;
 }
 
 bool CitizenVector::add(Node* start, Node* end) {
-	if (inactive.size() < NUM_CITIZEN_WORKER_THREADS) {
-		if (size() > maxSize) {
-			return false;
-		}
-		Citizen c = Citizen();
-		if (!start->findPath(end, c.path, &c.pathSize)) {
-			return false;
-		}
-		c.reset();
-		{
-			std::lock_guard<std::mutex> citizensLock(citizensMutex);
-			vec.push_back(c);
-		}
+	if (activeSize() >= maxSize) {
+		return false;
 	}
-	else {
-		Citizen* c;
-		{
-			std::lock_guard<std::mutex> stackLock(blockStack);
-			c = inactive.top();
-			inactive.pop();
-		}
-		if (c == nullptr) {
-			#if CITIZEN_SPAWN_ERRORS == true
-			std::cout << "ERR: found nullptr reference in CitizenVector stack" << std::endl;
-			#endif
-			return false;
-		}
-		if (!start->findPath(end, c->path, &c->pathSize)) {
-			{
-				std::lock_guard<std::mutex> stackLock(blockStack);
-				inactive.push(c);
-			}
-			return false;
-		}
-
-		c->reset();
+	PathHandle p = start->findPath(end);
+	if (p == NULL_PATH) {
+		return false;
 	}
-	return true;
+	return admit(p);
 }
 
-bool CitizenVector::remove(int index) {
-	inactive.push(&vec[index]);
+bool CitizenVector::admit(PathHandle p) {
+	unsigned int id = allocate();
+	if (id == CITIZEN_NO_SLOT) {
+		paths.release(p);
+		return false;
+	}
+
+	CitizenChunk* c = chunk(id);
+	unsigned int i = id & CITIZEN_CHUNK_MASK;
+	c->path[i] = p;
+	c->status[i] = STATUS_SPAWNED;
+	c->index[i] = 0;
+	c->timer[i] = 0;
+	c->currentTrain[i] = nullptr;
+
+	unsigned int head = spawnHead.load(std::memory_order_relaxed);
+	do {
+		c->next[i].store(head, std::memory_order_relaxed);
+	} while (!spawnHead.compare_exchange_weak(head, id, std::memory_order_acq_rel));
+	citizenWheel.scheduleLater(id);
 	return true;
 }
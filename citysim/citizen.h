@@ -1,94 +1,189 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <iostream>
-#include <mutex>
-#include <stack>
+#include <vector>
 #include "macros.h"
 #include "util.h"
 #include "train.h"
 #include "line.h"
+#include "patharena.h"
+#include "platform.h"
+#include "timerwheel.h"
 
+extern PathArena paths;
+extern TimerWheel citizenWheel;
+extern Line WALKING_LINE;
+
+// view of one citizen's fields inside a CitizenVector, used for debugging
 class Citizen {
 public:
-	float timer;
-	char status;
-	char index;
-	char pathSize;
-	char statusForward;
-	float dist;
-	Train* currentTrain;
-	Node* currentNode;
-	Line* currentLine;
-	Node* nextNode;
-	PathWrapper path[CITIZEN_PATH_SIZE]; // path.line[i] is used to travel between path.node[i] and path.node[i+1]
-
-	void reset();
-	std::string currentPathStr();
-
-	inline bool moveDownPath() {
-		if (++index > pathSize - 1) {
-			timer = 0;
-			status = STATUS_DESPAWNED;
-			return true;
-		}
-		timer = 0;
-		currentNode = path[index].node;
-		currentLine = path[index].line;
-		nextNode = path[index + 1].node;
-		return false;
+	char& status;
+	unsigned char& index; // current leg
+	PathHandle& path; // legs shared with other citizens
+	float& timer; // length of the current walk/transfer, in ticks
+	unsigned long& spawnTick; // tick of the citizen's first update
+	unsigned long& waitTick; // tick the citizen last entered a platform queue
+	Train*& currentTrain;
+
+	inline const PathLeg& currentLeg() const {
+		return paths.legs(path)[index];
 	}
+	std::string currentPathStr() const;
+};
 
-	inline bool switch_WALK() {
-		if (nextNode == nullptr) {
-			status = STATUS_DESPAWNED;
-			return true;
-		}
-		else {
-			status = STATUS_WALK;
-			dist = currentNode->dist(nextNode);
-			return false;
+// station arrivals recorded by one worker during a batch, applied at the tick barrier so node counters stay exact
+class NodeArrivals {
+public:
+	inline void add(Node* node) {
+		arrivals.push_back(node);
+	}
+	inline void apply() {
+		for (Node* node : arrivals) {
+			node->capacity++;
+			node->totalRiders++;
 		}
+		arrivals.clear();
 	}
+private:
+	std::vector<Node*> arrivals;
+};
 
-	inline void switch_TRANSFER() {
-		timer = 0;
-		status = STATUS_TRANSFER;
-		currentNode->capacity++;
-		currentNode->totalRiders++;
-	}
+// CITIZEN_CHUNK_SIZE citizens stored as a structure of arrays
+// hot arrays are touched whenever a citizen is woken, boarded or dropped off, cold arrays only by the debug report
+struct CitizenChunk {
+	// hot
+	char status[CITIZEN_CHUNK_SIZE];
+	unsigned char index[CITIZEN_CHUNK_SIZE]; // current leg
+	PathHandle path[CITIZEN_CHUNK_SIZE];
 
-	bool updatePositionAlongPath();
-	bool cull();
+	// cold
+	float timer[CITIZEN_CHUNK_SIZE];
+	unsigned long spawnTick[CITIZEN_CHUNK_SIZE];
+	unsigned long waitTick[CITIZEN_CHUNK_SIZE];
+	Train* currentTrain[CITIZEN_CHUNK_SIZE];
+	unsigned int livePos[CITIZEN_CHUNK_SIZE]; // position in the live index
+	std::atomic<unsigned int> next[CITIZEN_CHUNK_SIZE]; // free-list link while the slot is unused, spawn-list link right after add()
 };
 
+// citizens stored in fixed-size chunks that never move once allocated, a citizen's id is its slot number
+// slots are handed out and returned through a lock-free free-list, so any thread may add or remove citizens
+// only due citizens are ever visited (walking/transferring ones through the TimerWheel, the rest by trains)
+// live citizens are also kept in a dense index for anything that needs all of them (debug report, verification)
 class CitizenVector {
 public:
 	CitizenVector(size_t reserve, size_t maxS);
+	~CitizenVector();
 
-	Citizen operator [](int i) const {
-		return vec[i];
-	}
-	Citizen& operator [](int i) {
-		return vec[i];
+	Citizen operator [](unsigned int id) {
+		CitizenChunk* c = chunk(id);
+		unsigned int i = id & CITIZEN_CHUNK_MASK;
+		return Citizen{ c->status[i], c->index[i], c->path[i], c->timer[i], c->spawnTick[i], c->waitTick[i], c->currentTrain[i] };
 	}
 
+	// slots ever handed out
 	inline size_t size() {
-		return vec.size();
+		return used.load(std::memory_order_acquire);
 	}
 	inline size_t activeSize() {
-		return vec.size() - inactive.size();
+		return size() - freeCount.load(std::memory_order_relaxed);
 	}
 	inline size_t capacity() {
-		return vec.capacity();
+		return size_t(numChunks.load(std::memory_order_relaxed)) * CITIZEN_CHUNK_SIZE;
 	}
 	inline size_t max() {
 		return maxSize;
 	}
+	// live index, only valid on the simulation thread (or while it is paused)
+	inline size_t liveSize() {
+		return numLive;
+	}
+	inline unsigned int liveId(size_t i) {
+		return live[i];
+	}
+	// bytes stored per citizen across all arrays
+	static constexpr size_t citizenBytes() {
+		return sizeof(CitizenChunk) / CITIZEN_CHUNK_SIZE;
+	}
 
 	bool add(Node* start, Node* end);
-	bool remove(int index);
+	// spawns a citizen along an already solved path, taking over its reference (released if there is no free slot)
+	bool admit(PathHandle path);
+	// worker side of a despawn, releases the path but keeps the slot until compact()
+	void despawn(unsigned int id);
+	// simulation thread, between worker batches: adds citizens spawned since the last call to the live index,
+	// then swap-removes the despawned ones and gives their slots back to the free-list
+	void compact(std::vector<unsigned int>& despawned);
+
+	// only called on the tick the citizen is due, returns true once the citizen has despawned
+	// citizens entering a station are recorded in arrivals rather than counted on the node directly
+	bool update(unsigned int id, NodeArrivals& arrivals);
+	// simulation thread, between worker batches: queues a citizen that just reached STATUS_AT_STOP on its platform
+	// (done in due order rather than by the workers, so boarding order doesn't depend on thread timing)
+	void enterPlatform(unsigned int id);
+
+	// ticks since the citizen entered its platform queue if it is waiting for or riding a train, 0 otherwise
+	inline unsigned long waited(unsigned int id, unsigned long tick) {
+		CitizenChunk* c = chunk(id);
+		unsigned int i = id & CITIZEN_CHUNK_MASK;
+		char status = c->status[i];
+		return status == STATUS_AT_STOP || status == STATUS_IN_TRANSIT ? tick - c->waitTick[i] : 0;
+	}
+
+	// ticks until the citizen has to be updated again (see TimerWheel), 0 if trains will wake it instead
+	inline unsigned int wakeDelay(unsigned int id) {
+		CitizenChunk* c = chunk(id);
+		unsigned int i = id & CITIZEN_CHUNK_MASK;
+		switch (c->status[i]) {
+		case STATUS_WALK:
+			{
+				const PathLeg& leg = paths.legs(c->path[i])[c->index[i]];
+				c->timer[i] = leg.board->dist(leg.alight) / CITIZEN_SPEED;
+			}
+			return (unsigned int)c->timer[i] + 1;
+		case STATUS_TRANSFER:
+			c->timer[i] = CITIZEN_TRANSFER_THRESH / CITIZEN_SPEED;
+			return (unsigned int)c->timer[i] + 1;
+		default:
+			return 0;
+		}
+	}
+
+	// called by trains during the (sequential) train update, see Train::boardRiders and Train::alightRiders
+	inline void board(unsigned int id, Train* train) {
+		CitizenChunk* c = chunk(id);
+		unsigned int i = id & CITIZEN_CHUNK_MASK;
+		paths.legs(c->path[i])[c->index[i]].board->capacity--;
+		c->currentTrain[i] = train;
+		c->status[i] = STATUS_IN_TRANSIT;
+	}
+
+	inline void alight(unsigned int id) {
+		CitizenChunk* c = chunk(id);
+		unsigned int i = id & CITIZEN_CHUNK_MASK;
+		c->currentTrain[i] = nullptr;
+		c->status[i] = STATUS_ALIGHTED;
+	}
 private:
 	size_t maxSize;
-	std::vector<Citizen> vec;
-	std::stack<Citizen*> inactive;
-};
\ No newline at end of file
+	std::atomic<CitizenChunk*>* chunks; // enough entries for maxSize citizens, filled in as slots are first used
+	std::atomic<unsigned int> numChunks;
+	std::atomic<unsigned int> used; // slots handed out at least once
+	std::atomic<unsigned int> freeCount;
+	// free-list head, the low 32 bits are the first free id and the high 32 bits are bumped on every change (avoids ABA)
+	std::atomic<uint64_t> freeHead;
+	// citizens added since the last compact(), only ever pushed to or taken whole, so it needs no tag
+	std::atomic<unsigned int> spawnHead;
+	unsigned int* live;
+	size_t numLive;
+
+	inline CitizenChunk* chunk(unsigned int id) {
+		return chunks[id >> CITIZEN_CHUNK_BITS].load(std::memory_order_relaxed);
+	}
+	CitizenChunk* ensureChunk(unsigned int id);
+	// returns CITIZEN_NO_SLOT if every slot is in use
+	unsigned int allocate();
+	void release(unsigned int id);
+	void startLeg(unsigned int id, NodeArrivals& arrivals);
+};
@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <cfloat>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include "contraction.h"
+#include "pathfinder.h"
+
+extern Node* nodes;
+extern int VALID_NODES;
+extern PathGraph pathGraph;
+
+typedef std::pair<float, uint32_t> QueueEntry;
+
+// per-thread query scratch space, reset by bumping the generation counter
+struct CHSearch {
+    unsigned int generation = 0;
+    std::vector<unsigned int> reached[2];
+    std::vector<float> dist[2];
+    std::vector<uint32_t> parent[2];
+    std::vector<QueueEntry> queue[2];
+    std::vector<uint32_t> chain;
+    unsigned int expanded = 0;
+
+    void prepare(size_t numStates) {
+        if (reached[0].size() != numStates || ++generation == 0) {
+            for (int d = 0; d < 2; d++) {
+                reached[d].assign(numStates, 0);
+                dist[d].resize(numStates);
+                parent[d].resize(numStates);
+            }
+            generation = 1;
+        }
+        queue[0].clear();
+        queue[1].clear();
+        chain.clear();
+        expanded = 0;
+    }
+};
+
+thread_local CHSearch search;
+
+ContractionHierarchy::ContractionHierarchy() {
+    shortcuts = 0;
+}
+
+unsigned int ContractionHierarchy::expanded() {
+    return search.expanded;
+}
+
+uint32_t ContractionHierarchy::addState(uint32_t node, Line* line) {
+    stateNode.push_back(node);
+    stateLine.push_back(line);
+    return (uint32_t)(stateNode.size() - 1);
+}
+
+void ContractionHierarchy::build() {
+    stateNode.clear();
+    stateLine.clear();
+    edges.clear();
+    hub.assign(VALID_NODES, 0);
+
+    for (int i = 0; i < VALID_NODES; i++) {
+        hub[i] = addState(i, nullptr);
+    }
+
+    // (station, line) states are created on demand along with their boarding and alighting edges
+    std::vector<std::vector<uint32_t>> lineStates(VALID_NODES);
+    auto stateOf = [this, &lineStates](uint32_t node, Line* line) {
+        for (uint32_t s : lineStates[node]) {
+            if (stateLine[s] == line) return s;
+        }
+        uint32_t s = addState(node, line);
+        lineStates[node].push_back(s);
+        edges.push_back(CHEdge{ hub[node], s, 0.0f, -1, -1 });
+        edges.push_back(CHEdge{ s, hub[node], TRANSFER_PENALTY, -1, -1 });
+        return s;
+    };
+
+    for (uint32_t i = 0; i < pathGraph.numNodes(); i++) {
+        for (uint32_t e = pathGraph.firstEdge(i); e < pathGraph.lastEdge(i); e++) {
+            const GraphEdge& edge = pathGraph.edge(e);
+            Line* line = pathGraph.lineOf(edge.line);
+            uint32_t from = stateOf(i, line);
+            uint32_t to = stateOf(edge.node, line);
+            edges.push_back(CHEdge{ from, to, edge.weight, -1, -1 });
+        }
+    }
+
+    contract();
+}
+
+void ContractionHierarchy::contract() {
+    size_t n = numStates();
+    std::vector<std::vector<uint32_t>> out(n);
+    std::vector<std::vector<uint32_t>> in(n);
+    for (uint32_t e = 0; e < edges.size(); e++) {
+        out[edges[e].from].push_back(e);
+        in[edges[e].to].push_back(e);
+    }
+    std::vector<bool> contracted(n, false);
+    std::vector<int> deletedNeighbors(n, 0);
+    rank.assign(n, 0);
+    shortcuts = 0;
+
+    // bounded dijkstra from source over uncontracted states, never passing through skip
+    std::vector<float> witnessDist(n, FLT_MAX);
+    std::vector<uint32_t> touched;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> witnessQueue;
+    auto witnessSearch = [&](uint32_t source, uint32_t skip, float limit) {
+        for (uint32_t t : touched) witnessDist[t] = FLT_MAX;
+        touched.clear();
+        witnessQueue = decltype(witnessQueue)();
+        witnessDist[source] = 0.0f;
+        touched.push_back(source);
+        witnessQueue.push({ 0.0f, source });
+        int settled = 0;
+        while (!witnessQueue.empty()) {
+            QueueEntry top = witnessQueue.top();
+            witnessQueue.pop();
+            if (top.first > witnessDist[top.second]) continue;
+            if (top.first > limit || ++settled > CH_WITNESS_SETTLE_LIMIT) break;
+            for (uint32_t e : out[top.second]) {
+                uint32_t w = edges[e].to;
+                if (contracted[w] || w == skip) continue;
+                float d = top.first + edges[e].weight;
+                if (d < witnessDist[w]) {
+                    if (witnessDist[w] == FLT_MAX) touched.push_back(w);
+                    witnessDist[w] = d;
+                    witnessQueue.push({ d, w });
+                }
+            }
+        }
+    };
+
+    // counts (and optionally adds) the shortcuts needed to remove v from the remaining graph
+    auto contractState = [&](uint32_t v, bool apply) {
+        int added = 0;
+        std::vector<uint32_t> inEdges = in[v];
+        for (uint32_t ein : inEdges) {
+            uint32_t u = edges[ein].from;
+            if (contracted[u]) continue;
+            float maxOut = -1.0f;
+            for (uint32_t eout : out[v]) {
+                uint32_t w = edges[eout].to;
+                if (!contracted[w] && w != u) maxOut = std::max(maxOut, edges[eout].weight);
+            }
+            if (maxOut < 0.0f) continue;
+
+            witnessSearch(u, v, edges[ein].weight + maxOut);
+            std::vector<uint32_t> outEdges = out[v];
+            for (uint32_t eout : outEdges) {
+                uint32_t w = edges[eout].to;
+                if (contracted[w] || w == u) continue;
+                float via = edges[ein].weight + edges[eout].weight;
+                if (witnessDist[w] <= via) continue;
+                added++;
+                if (!apply) continue;
+
+                // replace a heavier parallel edge instead of keeping both
+                for (size_t k = 0; k < out[u].size(); k++) {
+                    uint32_t old = out[u][k];
+                    if (edges[old].to == w && edges[old].weight > via) {
+                        out[u].erase(out[u].begin() + k);
+                        in[w].erase(std::find(in[w].begin(), in[w].end(), old));
+                        break;
+                    }
+                }
+                edges.push_back(CHEdge{ u, w, via, (int32_t)ein, (int32_t)eout });
+                out[u].push_back((uint32_t)(edges.size() - 1));
+                in[w].push_back((uint32_t)(edges.size() - 1));
+                shortcuts++;
+            }
+        }
+        return added;
+    };
+
+    auto priority = [&](uint32_t v) {
+        int degree = 0;
+        for (uint32_t e : in[v]) degree += !contracted[edges[e].from];
+        for (uint32_t e : out[v]) degree += !contracted[edges[e].to];
+        return contractState(v, false) - degree + deletedNeighbors[v];
+    };
+
+    // lazy-update node ordering by edge difference
+    std::priority_queue<std::pair<int, uint32_t>, std::vector<std::pair<int, uint32_t>>, std::greater<std::pair<int, uint32_t>>> order;
+    for (uint32_t v = 0; v < n; v++) {
+        order.push({ priority(v), v });
+    }
+    uint32_t nextRank = 0;
+    while (!order.empty()) {
+        uint32_t v = order.top().second;
+        order.pop();
+        int p = priority(v);
+        if (!order.empty() && p > order.top().first) {
+            order.push({ p, v });
+            continue;
+        }
+        contractState(v, true);
+        contracted[v] = true;
+        rank[v] = nextRank++;
+        for (uint32_t e : in[v]) deletedNeighbors[edges[e].from]++;
+        for (uint32_t e : out[v]) deletedNeighbors[edges[e].to]++;
+    }
+
+    // split all edges into upward (forward search) and downward (backward search) graphs
+    for (int d = 0; d < 2; d++) {
+        first[d].assign(n + 1, 0);
+    }
+    for (const CHEdge& e : edges) {
+        if (rank[e.to] > rank[e.from]) first[0][e.from + 1]++;
+        else first[1][e.to + 1]++;
+    }
+    for (int d = 0; d < 2; d++) {
+        for (size_t v = 0; v < n; v++) {
+            first[d][v + 1] += first[d][v];
+        }
+        arcs[d].resize(first[d][n]);
+    }
+    std::vector<uint32_t> fill[2] = { std::vector<uint32_t>(first[0].begin(), first[0].end() - 1), std::vector<uint32_t>(first[1].begin(), first[1].end() - 1) };
+    for (uint32_t e = 0; e < edges.size(); e++) {
+        const CHEdge& edge = edges[e];
+        if (rank[edge.to] > rank[edge.from]) arcs[0][fill[0][edge.from]++] = CHArc{ edge.to, edge.weight, e };
+        else arcs[1][fill[1][edge.to]++] = CHArc{ edge.from, edge.weight, e };
+    }
+}
+
+// appends the original edges represented by edge, only ride edges produce path steps
+void ContractionHierarchy::unpack(uint32_t edge, PathWrapper* destPath, int* size, bool* overflow) {
+    const CHEdge& e = edges[edge];
+    if (e.child1 >= 0) {
+        unpack(e.child1, destPath, size, overflow);
+        unpack(e.child2, destPath, size, overflow);
+        return;
+    }
+    Line* line = stateLine[e.from];
+    if (line == nullptr || stateLine[e.to] == nullptr) return;
+    if (*size >= VALID_NODES - 1) {
+        *overflow = true;
+        return;
+    }
+    destPath[(*size)++] = PathWrapper{ &nodes[stateNode[e.from]], line };
+}
+
+bool ContractionHierarchy::query(Node* start, Node* end, PathWrapper* destPath, int* destPathSize, int* numTransfers) {
+    search.prepare(numStates());
+    unsigned int gen = search.generation;
+    uint32_t source = hub[start->numerID];
+    uint32_t target = hub[end->numerID];
+    uint32_t endpoints[2] = { source, target };
+    auto greater = std::greater<QueueEntry>();
+
+    for (int d = 0; d < 2; d++) {
+        search.reached[d][endpoints[d]] = gen;
+        search.dist[d][endpoints[d]] = 0.0f;
+        search.queue[d].push_back({ 0.0f, endpoints[d] });
+    }
+
+    float best = FLT_MAX;
+    uint32_t meet = UINT32_MAX;
+    while (true) {
+        // expand whichever direction has the smaller key, a direction is done once its key reaches the best meeting cost
+        int d = -1;
+        for (int k = 0; k < 2; k++) {
+            if (search.queue[k].empty() || search.queue[k].front().first >= best) continue;
+            if (d == -1 || search.queue[k].front().first < search.queue[d].front().first) d = k;
+        }
+        if (d == -1) break;
+
+        std::pop_heap(search.queue[d].begin(), search.queue[d].end(), greater);
+        QueueEntry top = search.queue[d].back();
+        search.queue[d].pop_back();
+        uint32_t u = top.second;
+        if (top.first > search.dist[d][u]) continue;
+        search.expanded++;
+
+        if (search.reached[1 - d][u] == gen && top.first + search.dist[1 - d][u] < best) {
+            best = top.first + search.dist[1 - d][u];
+            meet = u;
+        }
+
+        // stall-on-demand: skip u if a higher state already reached in this direction offers a shorter way to it
+        bool stalled = false;
+        for (uint32_t k = first[1 - d][u]; k < first[1 - d][u + 1]; k++) {
+            const CHArc& arc = arcs[1 - d][k];
+            if (search.reached[d][arc.node] == gen && search.dist[d][arc.node] + arc.weight < top.first) {
+                stalled = true;
+                break;
+            }
+        }
+        if (stalled) continue;
+
+        for (uint32_t k = first[d][u]; k < first[d][u + 1]; k++) {
+            const CHArc& arc = arcs[d][k];
+            float dist = top.first + arc.weight;
+            if (search.reached[d][arc.node] != gen || dist < search.dist[d][arc.node]) {
+                search.reached[d][arc.node] = gen;
+                search.dist[d][arc.node] = dist;
+                search.parent[d][arc.node] = arc.edge;
+                search.queue[d].push_back({ dist, arc.node });
+                std::push_heap(search.queue[d].begin(), search.queue[d].end(), greater);
+            }
+        }
+    }
+
+    if (meet == UINT32_MAX || start == end) return false;
+
+    // collect the edge chain start -> meet -> end, then unpack shortcuts into stops
+    std::vector<uint32_t>& chain = search.chain;
+    for (uint32_t v = meet; v != source; v = edges[search.parent[0][v]].from) {
+        chain.push_back(search.parent[0][v]);
+    }
+    std::reverse(chain.begin(), chain.end());
+    for (uint32_t v = meet; v != target; v = edges[search.parent[1][v]].to) {
+        chain.push_back(search.parent[1][v]);
+    }
+
+    int size = 0;
+    bool overflow = false;
+    for (size_t i = 0; i < chain.size() && !overflow; i++) {
+        unpack(chain[i], destPath, &size, &overflow);
+    }
+    if (overflow || size == 0) {
+        #if PATHFINDER_ERRORS == true
+        std::cout << "ERR: encountered large path [" << start->id << " : " << end->id << " ]" << std::endl;
+        #endif
+        return false;
+    }
+
+    destPath[size] = PathWrapper{ end, destPath[size - 1].line };
+    *destPathSize = size + 1;
+    *numTransfers = countTransfers(destPath, size + 1);
+    return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "macros.h"
+#include "node.h"
+
+// edge in the state graph, shortcuts remember the two edges they replace so they can be unpacked
+struct CHEdge {
+    uint32_t from;
+    uint32_t to;
+    float weight;
+    int32_t child1; // -1 for original edges
+    int32_t child2;
+};
+
+// entry in the upward/downward search graphs
+struct CHArc {
+    uint32_t node;
+    float weight;
+    uint32_t edge;
+};
+
+// contraction hierarchy over an expanded (station, line) state graph
+// every station has a hub state and one state per line (or walking) serving it:
+//   hub -> (station, line) costs nothing (boarding), (station, line) -> hub costs TRANSFER_PENALTY (alighting),
+//   (station, line) -> (neighbor, line) costs the edge weight, so line changes are always penalized exactly once
+// queries run from the start hub to the end hub, which matches the A* cost model (first boarding is penalized too)
+class ContractionHierarchy {
+public:
+    ContractionHierarchy();
+
+    // builds the state graph from the PathGraph and contracts it, call once the graph is built
+    void build();
+
+    // bidirectional upward search, writes the unpacked path in the same format as PathfindingContext::aStar
+    bool query(Node* start, Node* end, PathWrapper* destPath, int* destPathSize, int* numTransfers);
+
+    // states settled by the last query on this thread
+    unsigned int expanded();
+
+    inline bool built() {
+        return !rank.empty();
+    }
+    inline size_t numStates() {
+        return stateNode.size();
+    }
+    inline size_t numShortcuts() {
+        return shortcuts;
+    }
+private:
+    // state graph
+    std::vector<uint32_t> stateNode; // station of each state
+    std::vector<Line*> stateLine; // nullptr for hubs
+    std::vector<uint32_t> hub; // hub state of each station
+    std::vector<CHEdge> edges;
+    std::vector<uint32_t> rank;
+    size_t shortcuts;
+
+    // search graphs in CSR form, [0] holds out-edges to higher ranks (forward search), [1] in-edges from higher ranks (backward search)
+    std::vector<uint32_t> first[2];
+    std::vector<CHArc> arcs[2];
+
+    uint32_t addState(uint32_t node, Line* line);
+    void contract();
+    void unpack(uint32_t edge, PathWrapper* destPath, int* size, bool* overflow);
+};
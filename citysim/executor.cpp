@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <chrono>
+#include "executor.h"
+
+static inline double seconds() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TickExecutor::TickExecutor(unsigned int threads) {
+	numThreads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+	shares = new Share[numThreads];
+	for (unsigned int i = 0; i < numThreads; i++) {
+		shares[i].next = 0;
+		shares[i].end = 0;
+		shares[i].busy = 0;
+	}
+	job = nullptr;
+	jobContext = nullptr;
+	generation = 0;
+	remaining = 0;
+	stop = false;
+	resetStats();
+
+	for (unsigned int i = 1; i < numThreads; i++) {
+		workers.emplace_back([this, i] { workerThread(i); });
+	}
+}
+
+// workers only leave between calls, so no work can be left behind on shutdown
+TickExecutor::~TickExecutor() {
+	{
+		std::lock_guard<std::mutex> barrierLock(barrierMutex);
+		stop = true;
+	}
+	startCV.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	delete[] shares;
+}
+
+void TickExecutor::resetStats() {
+	idle = 0;
+	imbalance = 1;
+	totalIdle = 0;
+	totalImbalance = 0;
+	calls = 0;
+}
+
+double TickExecutor::averageIdle() {
+	return calls > 0 ? totalIdle / calls : 0;
+}
+
+double TickExecutor::averageImbalance() {
+	return calls > 0 ? totalImbalance / calls : 1;
+}
+
+void TickExecutor::run(size_t count, Job j, void* context) {
+	job = j;
+	jobContext = context;
+
+	// small batches are not worth waking the team for, and are left out of the statistics
+	unsigned int team = count > EXECUTOR_GRAIN ? numThreads : 1;
+	size_t perWorker = (count + team - 1) / team;
+	for (unsigned int i = 0; i < numThreads; i++) {
+		shares[i].next = std::min(i * perWorker, count);
+		shares[i].end = i < team ? std::min((i + 1) * perWorker, count) : count;
+		shares[i].busy = 0;
+	}
+
+	if (team == 1) {
+		work(0);
+		idle = 0;
+		imbalance = 1;
+		return;
+	}
+
+	double start = seconds();
+	remaining = numThreads - 1;
+	{
+		std::lock_guard<std::mutex> barrierLock(barrierMutex);
+		generation++;
+	}
+	startCV.notify_all();
+
+	work(0);
+
+	{
+		std::unique_lock<std::mutex> barrierLock(barrierMutex);
+		doneCV.wait(barrierLock, [this] { return remaining == 0; });
+	}
+
+	// every worker could have been busy for the whole call
+	double wall = seconds() - start;
+	double busy = 0, maxBusy = 0;
+	for (unsigned int i = 0; i < numThreads; i++) {
+		busy += shares[i].busy;
+		maxBusy = std::max(maxBusy, shares[i].busy);
+	}
+	idle = wall > 0 ? std::max(0.0, 1.0 - busy / (wall * numThreads)) : 0;
+	imbalance = busy > 0 ? maxBusy / (busy / numThreads) : 1;
+	totalIdle += idle;
+	totalImbalance += imbalance;
+	calls++;
+}
+
+void TickExecutor::work(unsigned int worker) {
+	double start = seconds();
+	// own share first, then steal from the others
+	for (unsigned int k = 0; k < numThreads; k++) {
+		Share& share = shares[(worker + k) % numThreads];
+		while (true) {
+			size_t begin = share.next.fetch_add(EXECUTOR_GRAIN);
+			if (begin >= share.end) break;
+			job(jobContext, begin, std::min(begin + EXECUTOR_GRAIN, share.end), worker);
+		}
+	}
+	shares[worker].busy = seconds() - start;
+}
+
+void TickExecutor::workerThread(unsigned int worker) {
+	unsigned long seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> barrierLock(barrierMutex);
+			startCV.wait(barrierLock, [this, seen] { return stop || generation != seen; });
+			if (stop) return;
+			seen = generation;
+		}
+		work(worker);
+		if (--remaining == 0) {
+			std::lock_guard<std::mutex> barrierLock(barrierMutex);
+			doneCV.notify_one();
+		}
+	}
+}
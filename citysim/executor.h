@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "macros.h"
+
+// persistent team of worker threads running one parallel loop per call (once per simulation tick)
+// the calling thread joins in as worker 0, and the call returns once every worker has reached the barrier
+// indices are split evenly and claimed in blocks of EXECUTOR_GRAIN, workers that run out of their own share steal blocks from the others
+class TickExecutor {
+public:
+	// 0 threads uses std::thread::hardware_concurrency()
+	TickExecutor(unsigned int threads = 0);
+	~TickExecutor();
+
+	inline unsigned int size() {
+		return numThreads;
+	}
+
+	// calls fn(begin, end, worker) for blocks covering [0, count)
+	template<class F>
+	void parallelFor(size_t count, F& fn) {
+		run(count, [](void* context, size_t begin, size_t end, unsigned int worker) {
+			(*(F*)context)(begin, end, worker);
+		}, &fn);
+	}
+
+	// share of worker time spent waiting at the barrier, and slowest / average worker busy time
+	inline double lastIdle() {
+		return idle;
+	}
+	inline double lastImbalance() {
+		return imbalance;
+	}
+	// averages over every call since the last resetStats()
+	double averageIdle();
+	double averageImbalance();
+	void resetStats();
+private:
+	typedef void (*Job)(void* context, size_t begin, size_t end, unsigned int worker);
+
+	// each worker's share of the index range, on its own cache line so stealing does not cause false sharing
+	struct alignas(64) Share {
+		std::atomic<size_t> next;
+		size_t end;
+		double busy; // seconds spent working during the last call
+	};
+
+	unsigned int numThreads;
+	std::vector<std::thread> workers;
+	Share* shares;
+
+	Job job;
+	void* jobContext;
+	unsigned long generation; // bumped to release the workers into the next call
+	std::atomic<unsigned int> remaining; // helpers still working on the current call
+	bool stop;
+	std::mutex barrierMutex;
+	std::condition_variable startCV;
+	std::condition_variable doneCV;
+
+	double idle;
+	double imbalance;
+	double totalIdle;
+	double totalImbalance;
+	unsigned long calls;
+
+	void run(size_t count, Job j, void* context);
+	void work(unsigned int worker);
+	void workerThread(unsigned int worker);
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// plain 2d point in window units, the core never depends on the renderer's vector types
+struct Vec2 {
+	float x;
+	float y;
+
+	Vec2(float x = 0.0f, float y = 0.0f) : x(x), y(y) {}
+
+	inline Vec2 operator+(const Vec2& other) const {
+		return Vec2(x + other.x, y + other.y);
+	}
+	inline Vec2 operator-(const Vec2& other) const {
+		return Vec2(x - other.x, y - other.y);
+	}
+	inline Vec2 operator*(float s) const {
+		return Vec2(x * s, y * s);
+	}
+};
+
+inline float distance(const Vec2& a, const Vec2& b) {
+	Vec2 delta = b - a;
+	return sqrt(delta.x * delta.x + delta.y * delta.y);
+}
+
+// something placed on the map (stations, trains)
+class Positioned {
+public:
+	inline const Vec2& getPosition() const {
+		return position;
+	}
+
+	inline void setPosition(const Vec2& pos) {
+		position = pos;
+	}
+
+	inline void goTo(const Positioned* other) {
+		position = other->position;
+	}
+
+	inline Vec2 lerp(float t, const Positioned* other) const {
+		t = std::max(0.0f, std::min(t, 1.0f));
+		return position * (1.0f - t) + other->position * t;
+	}
+
+	inline float dist(const Positioned* other) const {
+		return distance(position, other->position);
+	}
+
+	inline float dist(float x, float y) const {
+		return distance(position, Vec2(x, y));
+	}
+
+private:
+	Vec2 position;
+};
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include "landmarks.h"
+#include "pathfinder.h"
+
+extern PathGraph pathGraph;
+
+typedef std::pair<float, uint32_t> QueueEntry;
+
+uint32_t Landmarks::stateOf(uint32_t node, uint32_t line) const {
+    uint32_t s = stateFirst[node];
+    while (stateLine[s] != line) s++;
+    return s;
+}
+
+Landmarks::Landmarks() {
+    numLandmarks = 0;
+}
+
+void Landmarks::build(int count) {
+    uint32_t numNodes = pathGraph.numNodes();
+    numLandmarks = 0;
+    landmarks.clear();
+    cost.clear();
+    if (numNodes == 0) return;
+
+    // edges are symmetric, so the lines of a node's edges are also the lines it can be arrived at on
+    stateFirst.assign(numNodes + 1, 0);
+    stateNode.clear();
+    stateLine.clear();
+    for (uint32_t n = 0; n < numNodes; n++) {
+        stateFirst[n] = (uint32_t)stateLine.size();
+        for (uint32_t e = pathGraph.firstEdge(n); e < pathGraph.lastEdge(n); e++) {
+            uint32_t line = pathGraph.edge(e).line;
+            if (std::find(stateLine.begin() + stateFirst[n], stateLine.end(), line) == stateLine.end()) {
+                stateNode.push_back(n);
+                stateLine.push_back(line);
+            }
+        }
+    }
+    stateFirst[numNodes] = (uint32_t)stateLine.size();
+
+    // farthest-first: each landmark is the node farthest from every landmark picked so far (the first one from node 0)
+    count = std::min<int>(count, numNodes);
+    std::vector<std::vector<float>> tables;
+    std::vector<float> costs;
+    solve(0, costs);
+    std::vector<float> closest = costs;
+    while ((int)landmarks.size() < count) {
+        uint32_t next = 0;
+        for (uint32_t n = 1; n < numNodes; n++) {
+            if (closest[n] > closest[next]) next = n;
+        }
+        if (closest[next] <= 0.0f) break; // every reachable node is a landmark already
+        solve(next, costs);
+        landmarks.push_back(next);
+        tables.push_back(costs);
+        for (uint32_t n = 0; n < numNodes; n++) {
+            if (landmarks.size() == 1 || costs[n] < closest[n]) closest[n] = costs[n];
+        }
+    }
+
+    numLandmarks = (int)landmarks.size();
+    cost.resize((size_t)numNodes * numLandmarks);
+    for (uint32_t n = 0; n < numNodes; n++) {
+        for (int l = 0; l < numLandmarks; l++) {
+            cost[(size_t)n * numLandmarks + l] = tables[l][n];
+        }
+    }
+}
+
+void Landmarks::solve(uint32_t source, std::vector<float>& dest) {
+    uint32_t numNodes = pathGraph.numNodes();
+    dest.assign(numNodes, -1.0f);
+    std::vector<float> dist(stateLine.size(), -1.0f);
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+
+    // the source has not boarded anything yet, so its first edge always pays the boarding penalty
+    dest[source] = 0.0f;
+    for (uint32_t e = pathGraph.firstEdge(source); e < pathGraph.lastEdge(source); e++) {
+        const GraphEdge& edge = pathGraph.edge(e);
+        uint32_t s = stateOf(edge.node, edge.line);
+        float c = edgeCost(edge.weight, GRAPH_NO_LINE, edge.line);
+        if (dist[s] < 0.0f || c < dist[s]) {
+            dist[s] = c;
+            queue.push({ c, s });
+        }
+    }
+
+    while (!queue.empty()) {
+        QueueEntry top = queue.top();
+        queue.pop();
+        uint32_t s = top.second;
+        if (top.first > dist[s]) continue;
+
+        uint32_t node = stateNode[s];
+        if (dest[node] < 0.0f || top.first < dest[node]) dest[node] = top.first;
+
+        for (uint32_t e = pathGraph.firstEdge(node); e < pathGraph.lastEdge(node); e++) {
+            const GraphEdge& edge = pathGraph.edge(e);
+            uint32_t next = stateOf(edge.node, edge.line);
+            float c = top.first + edgeCost(edge.weight, stateLine[s], edge.line);
+            if (dist[next] < 0.0f || c < dist[next]) {
+                dist[next] = c;
+                queue.push({ c, next });
+            }
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "macros.h"
+#include "pathgraph.h"
+
+// ALT (A*, landmarks, triangle inequality) lower bounds for the A* cost model
+// costs from each landmark are solved exactly over (station, arriving line) states, so transfer and boarding penalties count
+// every line segment pays one penalty in either direction, so cost(a, b) == cost(b, a) and one table serves both bounds
+class Landmarks {
+public:
+    Landmarks();
+
+    // picks count landmarks farthest-first and solves their cost tables, call once the PathGraph is built
+    void build(int count);
+
+    inline bool built() const {
+        return numLandmarks > 0;
+    }
+    inline int size() const {
+        return numLandmarks;
+    }
+
+    // lower bound on the cost of reaching to from a label at from, whatever line it arrived on (negative if there is none)
+    inline float estimate(uint32_t from, uint32_t to) const {
+        const float* a = &cost[(size_t)from * numLandmarks];
+        const float* b = &cost[(size_t)to * numLandmarks];
+        float bound = 0.0f;
+        for (int l = 0; l < numLandmarks; l++) {
+            // unreachable pairs are stored as -1 (never bound by that landmark)
+            if (a[l] < 0.0f || b[l] < 0.0f) continue;
+            float d = a[l] > b[l] ? a[l] - b[l] : b[l] - a[l];
+            if (d > bound) bound = d;
+        }
+        // a label arriving on the right line can skip the first boarding penalty
+        return bound - TRANSFER_PENALTY;
+    }
+private:
+    int numLandmarks;
+    std::vector<uint32_t> landmarks;
+    std::vector<float> cost; // cost[node * numLandmarks + landmark], a node's bounds are contiguous
+
+    // (station, arriving line) states of the graph, states of node are stateFirst[node] to stateFirst[node + 1]
+    std::vector<uint32_t> stateFirst;
+    std::vector<uint32_t> stateNode;
+    std::vector<uint32_t> stateLine;
+
+    uint32_t stateOf(uint32_t node, uint32_t line) const;
+
+    // exact A* cost model costs from source to every node, -1 if unreachable
+    void solve(uint32_t source, std::vector<float>& dest);
+};
@@ -0,0 +1,32 @@
+#include <algorithm>
+#include "line.h"
+#include "node.h"
+
+void Line::buildStopIndex() {
+	for (int i = 0; i < size; i++) {
+		stops[i] = LineStop{ path[i]->numerID, (unsigned int)i };
+	}
+	std::sort(stops, stops + size, [](const LineStop& a, const LineStop& b) {
+		return a.node != b.node ? a.node < b.node : a.index < b.index;
+	});
+}
+
+int Line::stopIndex(Node* node, Node* next) {
+	LineStop* visit = std::lower_bound(stops, stops + size, node->numerID, [](const LineStop& stop, unsigned int n) {
+		return stop.node < n;
+	});
+	if (visit == stops + size || visit->node != node->numerID) {
+		return LINE_NO_STOP;
+	}
+	if (next == nullptr) {
+		return visit->index;
+	}
+	// loops and branches: pick the visit next to the adjacent stop
+	for (LineStop* v = visit; v < stops + size && v->node == node->numerID; v++) {
+		int i = v->index;
+		if ((i > 0 && path[i - 1] == next) || (i < size - 1 && path[i + 1] == next)) {
+			return i;
+		}
+	}
+	return visit->index;
+}
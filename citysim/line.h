@@ -1,14 +1,36 @@
 #pragma once
 
-#include <SFML/Graphics.hpp>
+#include "macros.h"
 
 class Node;
 
+// rgba, only read by the renderer
+struct LineColor {
+	unsigned char r;
+	unsigned char g;
+	unsigned char b;
+	unsigned char a;
+};
+
+// stop of a line at a node, lines keep them sorted by node
+struct LineStop {
+	unsigned int node; // numerID
+	unsigned int index; // in path
+};
+
 struct Line {
 public:
-	char size;
+	int size; // number of stops
+	unsigned int firstStop; // offset of this line's stops in the network's stop arrays (see network.h)
 	char id[LINE_ID_SIZE];
-	sf::Color color;
-	Node* path[64];
-	float dist[64]; // dist[i] is equal to the distance between path[i] and path[i+1]
+	LineColor color;
+	Node** path;
+	float* dist; // dist[i] is equal to the distance between path[i] and path[i+1]
+	LineStop* stops; // one per stop, sorted by node so stopIndex can binary search
+
+	// fills stops, call once path and size are final
+	void buildStopIndex();
+	// index of node in path, next is an adjacent stop used to tell visits apart if the line serves node more than once
+	// returns LINE_NO_STOP if the line does not serve node
+	int stopIndex(Node* node, Node* next = nullptr);
 };
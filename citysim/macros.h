@@ -26,19 +26,21 @@
 #define NODE_SIZE_DIFF				NODE_MAX_SIZE - NODE_MIN_SIZE
 #define NODE_N_POINTS				8
 #define TEXT_REFRESH_RATE			10 // every n frames
+#define SNAPSHOT_FRESH				4u // flag on SnapshotBuffer's middle index, set until the renderer takes the snapshot
 #define BACKGROUND_COLOR			sf::Color::White
 
-// Simulation size
-#define MAX_LINES					32
-#define MAX_NODES					512
-#define MAX_TRAINS					1024
+// Simulation size (nodes, lines and trains are sized from the loaded network)
 #define MAX_CITIZENS				200000
-#define NUM_CITIZEN_WORKER_THREADS	8 // important to adjust for performance depending on your machine
+#define CITIZEN_WORKER_THREADS		0 // 0 uses std::thread::hardware_concurrency()
+#define EXECUTOR_GRAIN				64 // citizens claimed by a worker at a time
 #define DISTANCE_SCALE				128
 
 // File loading
+#define LINES_CSV_FILE				"lines_stations.csv"
+#define STATIONS_CSV_FILE			"stations_data.csv"
 #define STATIONS_CSV_NUM_COLUMNS	6
 #define GEOM_CSV_NUM_COLUMNS		9
+#define NETWORK_FILE				"network.bin" // compiled from the CSV files on first launch, see network.h
 
 // Node and Train status flags
 #define STATUS_DESPAWNED			0
@@ -52,9 +54,12 @@
 #define STATUS_BACKWARD				-1
 #define STATUS_AMBIVALENT			3
 #define STATUS_HIGHLIGHTED			2
+#define STATUS_ALIGHTED				7 // got off a train, continues with the next leg on its next update
+#define PLATFORM_FORWARD			0 // platform queue towards increasing stop indices
+#define PLATFORM_BACKWARD			1
 
 // Line
-#define LINE_PATH_SIZE				64
+#define LINE_NO_STOP				-1
 #define LINE_ID_SIZE				4 // size of char buffer
 #define WALK_LINE_ID_STR			"WLK"
 
@@ -63,6 +68,10 @@
 #define NODE_CAPACITY				256u // cosmetic only
 #define NODE_GRID_ROWS				10
 #define NODE_GRID_COLS				12
+#define NODE_ORDER_CSV				0 // keep the order of STATIONS_CSV_FILE
+#define NODE_ORDER_RCM				1 // reverse Cuthill-McKee over the station graph, keeps neighbors close in nodes[]
+#define NODE_ORDER_HILBERT			2 // Hilbert curve over station positions
+#define NODE_ORDER					NODE_ORDER_HILBERT // applied when the network is built from the CSV files
 
 // Train
 #define DEFAULT_TRAIN_STOP_SPACING	4 // spawn trains every n stops
@@ -74,23 +83,41 @@
 constexpr float CITIZEN_SPEED = 1.0f;
 #define	CITIZEN_TRANSFER_THRESH		64 * CITIZEN_SPEED // how long citizens walk through stations before waiting for a train
 #define CITIZEN_SPAWN_INIT			4000 // initial amount of citizens to spawn before simulation start
-#define CITIZEN_SPAWN_FREQ			1024 // spawn citizens every n simulation ticks
-#define CITIZEN_CULL_FREQ			4096 // cull citizens who have been stuck longer than CITIZEN_DESPAWN_THRESH every n simulation ticks
+#define CITIZEN_SPAWN_FREQ			1024 // fixed amount spawning adds CITIZEN_SPAWN_AMT citizens every n simulation ticks
 #define CITIZEN_SPAWN_METHOD		0 // 0 to match target amount, 1 for fixed amount (CITIZEN_SPAWN_AMT)
 #define CITIZEN_SPAWN_AMT			2000
+#define CITIZEN_SPAWN_BATCH			1024 // trips sampled at a time
+#define CITIZEN_ADMIT_PER_TICK		256 // most spawned citizens joining the simulation on one tick
+#define SPAWNER_THREADS				0 // 0 uses std::thread::hardware_concurrency()
+#define SPAWNER_READY_CAP			8192 // solved paths kept waiting for admission
 #define TARGET_CITIZEN_COUNT		40000
 #define CITIIZEN_VEC_RESERVE		TARGET_CITIZEN_COUNT * 2
+#define CITIZEN_CHUNK_BITS			12
+#define CITIZEN_CHUNK_SIZE			(1 << CITIZEN_CHUNK_BITS) // citizens allocated at a time, chunks never move
+#define CITIZEN_CHUNK_MASK			(CITIZEN_CHUNK_SIZE - 1)
+#define CITIZEN_NO_SLOT				0xFFFFFFFF
+#define CITIZEN_OUTCOME_DESPAWNED	0xFFFFFFFF
 #define CUSTOM_CITIZEN_SPAWN_AMT	250
+#define CITIZEN_CULL_FREQ			4096 // despawn citizens who have waited for or ridden a train longer than CITIZEN_DESPAWN_THRESH every n simulation ticks
 #define CITIZEN_DESPAWN_THRESH		CITIZEN_DESPAWN_WARN * 8
+#define TIMER_WHEEL_BITS			6
+#define TIMER_WHEEL_SLOTS			(1 << TIMER_WHEEL_BITS) // slots per timer wheel level
+#define TIMER_WHEEL_LEVELS			4 // covers 2^24 ticks before entries have to be rescheduled
 
 // Pathfinding
-#define CITIZEN_PATH_SIZE			64 // this value is not mathematically guaranteed to exceed the maximum number of possible lines in a path (but errors are handled)
-#define NODE_N_NEIGHBORS			16
-#define NODE_N_TRAINS				8
+#define PATH_MAX_LEGS				255 // citizens keep their current leg in a byte, longer paths count as not found
 #define TRANSFER_MAX_DIST			10.0f
 #define STOP_PENALTY				20 // fixed penalty for each stop
 #define TRANSFER_PENALTY			STOP_PENALTY * 2 // fixed penalty for transferring to another line/walking
 #define TRANSFER_PENALTY_MULTIPLIER TRAIN_SPEED / CITIZEN_SPEED // multiplier for distance walked during walking transfers
+#define PATHFINDING_ENGINE_ASTAR	0
+#define PATHFINDING_ENGINE_BIDIRECTIONAL 1 // bidirectional A*
+#define PATHFINDING_ENGINE_CH		2 // contraction hierarchy over (station, line) states
+#define PATHFINDING_ENGINE_ALT		3 // A* with landmark (ALT) lower bounds
+#define NUM_PATHFINDING_ENGINES		4
+#define DEFAULT_PATHFINDING_ENGINE	PATHFINDING_ENGINE_BIDIRECTIONAL // can be cycled at runtime with E, has no effect while a route table (USE_ROUTE_TABLE) is loaded
+#define ALT_LANDMARKS				16 // landmarks picked farthest-first, each adds a float per node to the bound tables
+#define CH_WITNESS_SETTLE_LIMIT		500 // max states settled per witness search during contraction (lower is faster, but adds more shortcuts)
 
 // PathCache
 constexpr int PATH_CACHE_BUCKETS = 200;
@@ -99,18 +126,42 @@ constexpr int CACHE_TRANSFERS_THRESHOLD = 2; // paths with n or different lines
 #define PRIME_1 541
 #define PRIME_2 1223
 
+// PathArena
+#define PATH_ARENA_SHARDS			64 // (start, end) lookup tables, each with its own lock
+#define PATH_ARENA_SHARD_CAPACITY	1024 // initial entries per lookup table, doubled once half full
+#define PATH_ARENA_CHUNK_BITS		12
+#define PATH_ARENA_CHUNK_SIZE		(1 << PATH_ARENA_CHUNK_BITS) // path slots allocated at a time, chunks never move
+#define PATH_ARENA_MAX_CHUNKS		4096
+
+// Route table
+#define USE_ROUTE_TABLE				true // solve all station pairs once (cached on disk) instead of pathfinding for every citizen
+#define ROUTE_TABLE_FILE			"routes.bin"
+#define ROUTE_TABLE_MAX_NODES		4096 // all pairs grow quadratically, larger networks always search (and cache)
+
 // Debugging
 #define AOK							0
 #define ERROR_OPENING_FILE			1
+#define ERROR_NETWORK_TOO_LARGE		2
+#define ERROR_INVALID_NETWORK		3
+#define RENDER_MODE					true // opens the SFML window (render.cpp) unless BENCHMARK_MODE is set, false runs headless without render.cpp or SFML
 #define BENCHMARK_MODE				false
 #define BENCHMARK_TICK_AMT			50000
 #define STAT_RATE					1000 // every n simulation ticks
 #define BENCHMARK_RESERVE			BENCHMARK_TICK_AMT / STAT_RATE * 2
+#define PATHFINDING_BENCHMARK_MODE	false // times PATHFINDING_BENCHMARK_AMT searches between random stations after init, then exits
+#define PATHFINDING_BENCHMARK_AMT	200000
+#define CH_VALIDATION_MODE			false // compares A* and contraction hierarchy path costs on CH_VALIDATION_AMT random pairs after init, then exits
+#define CH_VALIDATION_AMT			20000
+#define NETWORK_COMPILE_MODE		false // rebuilds NETWORK_FILE from the CSV files even if it is up to date, then exits
+#define DETERMINISTIC_MODE			false // fixed seeds and forward-only path cache lookups, prints a hash of citizen/train state chained over every tick
+#define DETERMINISTIC_SEED			20190101ull
+#define CITIZEN_VERIFY_MODE			false // checks every CITIZEN_VERIFY_RATE ticks that each live citizen is tracked exactly once, and that no citizen is updated twice in a tick
+#define CITIZEN_VERIFY_RATE			256
 #define USER_INFO_MODE				true
 #define PATHFINDER_ERRORS			false
 #define TRAIN_ERRORS				false
 #define CITIZEN_SPAWN_ERRORS		false
 #define DISABLE_SIMULATION			false
 #define NODE_CAPACITY_WARN			512
-#define CITIZEN_DESPAWN_WARN		500000 * CITIZEN_SPEED
+#define CITIZEN_DESPAWN_WARN		500000 // ticks waiting for or riding a train before a citizen counts as stuck
 #define CITIZEN_STUCK_THRESH		10 // ignore nodes with below n stuck citizens when outputting debug info
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+// read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const char* path);
+    void close();
+
+    inline const char* data() {
+        return ptr;
+    }
+    inline size_t size() {
+        return len;
+    }
+    inline bool isOpen() {
+        return ptr != nullptr;
+    }
+private:
+    const char* ptr;
+    size_t len;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fd;
+#endif
+};
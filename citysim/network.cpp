@@ -0,0 +1,504 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "network.h"
+#include "node.h"
+#include "train.h"
+#include "mappedfile.h"
+#include "util.h"
+
+extern unsigned int totalRidership;
+extern int NODE_GRID_ROW_SIZE;
+extern int NODE_GRID_COL_SIZE;
+extern std::vector<std::vector<std::vector<Node*>>> nodeGrid;
+extern int VALID_LINES;
+extern int VALID_NODES;
+extern int VALID_TRAINS;
+extern Line* lines;
+extern Node* nodes;
+extern Train* trains;
+extern Line WALKING_LINE;
+
+// pools shared by all lines and nodes
+static Node** stopNodes;
+static float* stopDists;
+static LineStop* stopIndices;
+static PathWrapper* edges;
+static float* edgeWeights;
+static Train** trainSlots;
+
+uint64_t network::sourceChecksum() {
+    uint64_t hash = util::hashBytes(&NETWORK_VERSION, sizeof(NETWORK_VERSION));
+    util::hashFile(LINES_CSV_FILE, &hash);
+    util::hashFile(STATIONS_CSV_FILE, &hash);
+
+    // position normalization, grid and neighbor generation, train placement and struct layout
+    const float layout[] = { WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_SCALE, WINDOW_X_SCALE, WINDOW_Y_SCALE, WINDOW_X_OFFSET, WINDOW_Y_OFFSET,
+        NODE_GRID_ROWS, NODE_GRID_COLS, TRANSFER_MAX_DIST, DISTANCE_SCALE, TRANSFER_PENALTY_MULTIPLIER, DEFAULT_TRAIN_STOP_SPACING,
+        NODE_ID_SIZE, LINE_ID_SIZE, NODE_ORDER };
+    return util::hashBytes(layout, sizeof(layout), hash);
+}
+
+bool network::fits(size_t numNodes, const std::vector<int>& lineSizes, size_t numTrains) {
+    size_t numStops = 0;
+    for (int size : lineSizes) {
+        numStops += size;
+    }
+    const char* what = nullptr;
+    if (numNodes > NETWORK_MAX_COUNT) what = "nodes";
+    else if (lineSizes.size() >= NETWORK_MAX_COUNT) what = "lines"; // NETWORK_WALK_LINE and the search graph's walking line come after them
+    else if (numStops > NETWORK_MAX_COUNT) what = "line stops";
+    else if (numTrains > NETWORK_MAX_COUNT) what = "trains";
+    if (what != nullptr) {
+        std::cerr << "Network has too many " << what << " (max " << NETWORK_MAX_COUNT << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void network::allocate(int numNodes, const std::vector<int>& lineSizes, int numTrains) {
+    delete[] nodes;
+    delete[] lines;
+    delete[] trains;
+    delete[] stopNodes;
+    delete[] stopDists;
+    delete[] stopIndices;
+
+    VALID_NODES = numNodes;
+    VALID_LINES = (int)lineSizes.size();
+    VALID_TRAINS = numTrains;
+    nodes = new Node[VALID_NODES];
+    lines = new Line[VALID_LINES]();
+    trains = new Train[VALID_TRAINS];
+    for (int i = 0; i < VALID_NODES; i++) {
+        nodes[i].numerID = i;
+    }
+
+    size_t numStops = 0;
+    for (int size : lineSizes) {
+        numStops += size;
+    }
+    stopNodes = new Node*[numStops]();
+    stopDists = new float[numStops]();
+    stopIndices = new LineStop[numStops];
+    unsigned int firstStop = 0;
+    for (int i = 0; i < VALID_LINES; i++) {
+        Line& line = lines[i];
+        line.size = lineSizes[i];
+        line.firstStop = firstStop;
+        line.path = stopNodes + firstStop;
+        line.dist = stopDists + firstStop;
+        line.stops = stopIndices + firstStop;
+        firstStop += line.size;
+    }
+    allocatePlatforms(numStops);
+}
+
+void network::setNeighbors(const std::vector<std::vector<std::pair<PathWrapper, float>>>& adjacency) {
+    delete[] edges;
+    delete[] edgeWeights;
+
+    size_t numEdges = 0;
+    for (int i = 0; i < VALID_NODES; i++) {
+        numEdges += adjacency[i].size();
+    }
+    edges = new PathWrapper[numEdges];
+    edgeWeights = new float[numEdges];
+    size_t e = 0;
+    for (int i = 0; i < VALID_NODES; i++) {
+        Node& node = nodes[i];
+        node.neighbors = edges + e;
+        node.weights = edgeWeights + e;
+        node.numNeighbors = (unsigned int)adjacency[i].size();
+        for (const std::pair<PathWrapper, float>& edge : adjacency[i]) {
+            edges[e] = edge.first;
+            edgeWeights[e] = edge.second;
+            e++;
+        }
+    }
+}
+
+void network::finalize() {
+    delete[] trainSlots;
+
+    std::vector<int> lineTrains(VALID_LINES, 0);
+    for (int i = 0; i < VALID_TRAINS; i++) {
+        lineTrains[trains[i].line - lines]++;
+        trains[i].riders.assign(trains[i].line->size, std::vector<unsigned int>());
+    }
+
+    // every train of every line serving a node can wait there at once
+    std::vector<size_t> slots(VALID_NODES, 0);
+    std::vector<int> lastLine(VALID_NODES, -1);
+    for (int i = 0; i < VALID_LINES; i++) {
+        Line& line = lines[i];
+        line.buildStopIndex();
+        for (int j = 0; j < line.size; j++) {
+            size_t n = line.path[j] - nodes;
+            if (lastLine[n] == i) continue;
+            lastLine[n] = i;
+            slots[n] += lineTrains[i];
+        }
+    }
+
+    size_t numSlots = 0;
+    for (int i = 0; i < VALID_NODES; i++) {
+        numSlots += slots[i];
+    }
+    trainSlots = new Train*[numSlots]();
+    size_t s = 0;
+    for (int i = 0; i < VALID_NODES; i++) {
+        nodes[i].trains = trainSlots + s;
+        nodes[i].numTrainSlots = (unsigned int)slots[i];
+        s += slots[i];
+    }
+}
+
+// breadth first from the lowest degree node of each component, visiting neighbors by increasing degree, then reversed
+static std::vector<uint32_t> cuthillMcKeeOrder() {
+    std::vector<std::vector<uint32_t>> adjacent(VALID_NODES);
+    for (int i = 0; i < VALID_NODES; i++) {
+        for (unsigned int j = 0; j < nodes[i].numNeighbors; j++) {
+            uint32_t n = (uint32_t)(nodes[i].neighbors[j].node - nodes);
+            if (n != (uint32_t)i && std::find(adjacent[i].begin(), adjacent[i].end(), n) == adjacent[i].end()) {
+                adjacent[i].push_back(n);
+            }
+        }
+    }
+    auto byDegree = [&adjacent](uint32_t a, uint32_t b) {
+        return adjacent[a].size() != adjacent[b].size() ? adjacent[a].size() < adjacent[b].size() : a < b;
+    };
+
+    std::vector<uint32_t> roots(VALID_NODES);
+    for (int i = 0; i < VALID_NODES; i++) {
+        roots[i] = i;
+    }
+    std::sort(roots.begin(), roots.end(), byDegree);
+
+    std::vector<uint32_t> order;
+    std::vector<bool> visited(VALID_NODES, false);
+    for (uint32_t root : roots) {
+        if (visited[root]) continue;
+        visited[root] = true;
+        order.push_back(root);
+        for (size_t head = order.size() - 1; head < order.size(); head++) {
+            std::vector<uint32_t> next;
+            for (uint32_t n : adjacent[order[head]]) {
+                if (!visited[n]) {
+                    visited[n] = true;
+                    next.push_back(n);
+                }
+            }
+            std::sort(next.begin(), next.end(), byDegree);
+            order.insert(order.end(), next.begin(), next.end());
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+// distance along a Hilbert curve filling a 2^16 x 2^16 grid
+static uint64_t hilbertIndex(uint32_t x, uint32_t y) {
+    uint64_t d = 0;
+    for (uint32_t s = 1u << 15; s > 0; s >>= 1) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += (uint64_t)s * s * ((3 * rx) ^ ry);
+        // rotate the quadrant so the curve stays continuous
+        if (ry == 0) {
+            if (rx == 1) {
+                x = 0xFFFF - x;
+                y = 0xFFFF - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+static std::vector<uint32_t> hilbertOrder() {
+    Vec2 low = nodes[0].getPosition();
+    Vec2 high = low;
+    for (int i = 0; i < VALID_NODES; i++) {
+        const Vec2& p = nodes[i].getPosition();
+        low = Vec2(std::min(low.x, p.x), std::min(low.y, p.y));
+        high = Vec2(std::max(high.x, p.x), std::max(high.y, p.y));
+    }
+    float scale = 65535.0f / std::max(std::max(high.x - low.x, high.y - low.y), 1.0f);
+
+    std::vector<uint64_t> key(VALID_NODES);
+    std::vector<uint32_t> order(VALID_NODES);
+    for (int i = 0; i < VALID_NODES; i++) {
+        Vec2 p = (nodes[i].getPosition() - low) * scale;
+        key[i] = hilbertIndex((uint32_t)p.x, (uint32_t)p.y);
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&key](uint32_t a, uint32_t b) {
+        return key[a] < key[b];
+    });
+    return order;
+}
+
+void network::renumber(int order) {
+    std::vector<uint32_t> oldIndex; // oldIndex[new] = old
+    if (order == NODE_ORDER_RCM) oldIndex = cuthillMcKeeOrder();
+    else if (order == NODE_ORDER_HILBERT) oldIndex = hilbertOrder();
+    else return;
+
+    std::vector<uint32_t> newIndex(VALID_NODES);
+    for (int i = 0; i < VALID_NODES; i++) {
+        newIndex[oldIndex[i]] = i;
+    }
+
+    Node* old = nodes;
+    nodes = new Node[VALID_NODES];
+    std::vector<std::vector<std::pair<PathWrapper, float>>> adjacency(VALID_NODES);
+    for (int i = 0; i < VALID_NODES; i++) {
+        Node& from = old[oldIndex[i]];
+        nodes[i] = from;
+        nodes[i].numerID = i;
+        for (unsigned int j = 0; j < from.numNeighbors; j++) {
+            Node* neighbor = &nodes[newIndex[from.neighbors[j].node - old]];
+            adjacency[i].push_back({ { neighbor, from.neighbors[j].line }, from.weights[j] });
+        }
+    }
+    for (int i = 0; i < VALID_LINES; i++) {
+        for (int j = 0; j < lines[i].size; j++) {
+            lines[i].path[j] = &nodes[newIndex[lines[i].path[j] - old]];
+        }
+    }
+    for (std::vector<std::vector<Node*>>& row : nodeGrid) {
+        for (std::vector<Node*>& cell : row) {
+            for (Node*& node : cell) {
+                node = &nodes[newIndex[node - old]];
+            }
+        }
+    }
+    delete[] old;
+
+    setNeighbors(adjacency);
+    finalize();
+}
+
+float network::meanEdgeSpan() {
+    double span = 0;
+    size_t numEdges = 0;
+    for (int i = 0; i < VALID_NODES; i++) {
+        for (unsigned int j = 0; j < nodes[i].numNeighbors; j++) {
+            span += std::abs((long)(nodes[i].neighbors[j].node - nodes) - i);
+            numEdges++;
+        }
+    }
+    return numEdges > 0 ? (float)(span / numEdges) : 0.0f;
+}
+
+bool network::load(const char* path, uint64_t checksum) {
+    MappedFile file;
+    if (!file.open(path)) return false;
+    const char* data = file.data();
+    size_t size = file.size();
+
+    const NetworkHeader* h = (const NetworkHeader*)data;
+    if (size < sizeof(NetworkHeader) || h->magic != NETWORK_MAGIC || h->version != NETWORK_VERSION || h->checksum != checksum) return false;
+    if (h->gridRows != NODE_GRID_ROWS || h->gridCols != NODE_GRID_COLS) return false;
+
+    size_t numCells = (size_t)h->gridRows * h->gridCols;
+    size_t expectedSize = sizeof(NetworkHeader) + (size_t)h->numNodes * sizeof(NetworkNode) + ((size_t)h->numNodes + 1) * sizeof(uint32_t)
+        + (size_t)h->numEdges * sizeof(NetworkEdge) + (size_t)h->numLines * sizeof(NetworkLine) + (size_t)h->numStops * sizeof(NetworkStop)
+        + (numCells + 1) * sizeof(uint32_t) + (size_t)h->numGridEntries * sizeof(uint32_t) + (size_t)h->numTrains * sizeof(NetworkTrain);
+    if (size != expectedSize) return false;
+
+    const NetworkNode* fileNodes = (const NetworkNode*)(data + sizeof(NetworkHeader));
+    const uint32_t* edgeOffsets = (const uint32_t*)(fileNodes + h->numNodes);
+    const NetworkEdge* fileEdges = (const NetworkEdge*)(edgeOffsets + h->numNodes + 1);
+    const NetworkLine* fileLines = (const NetworkLine*)(fileEdges + h->numEdges);
+    const NetworkStop* fileStops = (const NetworkStop*)(fileLines + h->numLines);
+    const uint32_t* gridOffsets = (const uint32_t*)(fileStops + h->numStops);
+    const uint32_t* gridNodes = (const uint32_t*)(gridOffsets + numCells + 1);
+    const NetworkTrain* fileTrains = (const NetworkTrain*)(gridNodes + h->numGridEntries);
+
+    std::vector<int> lineSizes(h->numLines);
+    size_t numStops = 0;
+    for (uint32_t i = 0; i < h->numLines; i++) {
+        lineSizes[i] = fileLines[i].size;
+        numStops += fileLines[i].size;
+    }
+    if (numStops != h->numStops) return false;
+    if (h->numEdges > NETWORK_MAX_COUNT || !fits(h->numNodes, lineSizes, h->numTrains)) return false;
+
+    // the checksum only covers the CSV files, so every index in the blob is checked before anything is replaced
+    // (a damaged blob is rejected and rebuilt instead of indexing out of bounds)
+    if (edgeOffsets[0] != 0 || edgeOffsets[h->numNodes] != h->numEdges) return false;
+    for (uint32_t i = 0; i < h->numNodes; i++) {
+        if (edgeOffsets[i] > edgeOffsets[i + 1]) return false;
+        if ((fileNodes[i].gridPos >> 8) >= h->gridRows || (fileNodes[i].gridPos & 0xFF) >= h->gridCols) return false;
+    }
+    for (uint32_t e = 0; e < h->numEdges; e++) {
+        if (fileEdges[e].node >= h->numNodes || (fileEdges[e].line >= h->numLines && fileEdges[e].line != NETWORK_WALK_LINE)) return false;
+    }
+    for (uint32_t s = 0; s < h->numStops; s++) {
+        if (fileStops[s].node >= h->numNodes) return false;
+    }
+    if (gridOffsets[0] != 0 || gridOffsets[numCells] != h->numGridEntries) return false;
+    for (size_t c = 0; c < numCells; c++) {
+        if (gridOffsets[c] > gridOffsets[c + 1]) return false;
+    }
+    for (uint32_t k = 0; k < h->numGridEntries; k++) {
+        if (gridNodes[k] >= h->numNodes) return false;
+    }
+    for (uint32_t t = 0; t < h->numTrains; t++) {
+        if (fileTrains[t].line >= h->numLines || fileTrains[t].index >= fileLines[fileTrains[t].line].size) return false;
+    }
+
+    allocate(h->numNodes, lineSizes, h->numTrains);
+    totalRidership = h->totalRidership;
+    NODE_GRID_ROW_SIZE = h->gridRowSize;
+    NODE_GRID_COL_SIZE = h->gridColSize;
+
+    std::vector<std::vector<std::pair<PathWrapper, float>>> adjacency(VALID_NODES);
+    for (int i = 0; i < VALID_NODES; i++) {
+        const NetworkNode& n = fileNodes[i];
+        Node& node = nodes[i];
+        std::memcpy(node.id, n.id, NODE_ID_SIZE);
+        node.id[NODE_ID_SIZE - 1] = '\0';
+        node.setPosition(Vec2(n.x, n.y));
+        node.ridership = n.ridership;
+        node.numerID = i; // every per-node array is indexed by it
+        node.gridPos = n.gridPos;
+        node.numLines = n.numLines;
+        node.status = STATUS_SPAWNED;
+        for (uint32_t e = edgeOffsets[i]; e < edgeOffsets[i + 1]; e++) {
+            Line* line = fileEdges[e].line == NETWORK_WALK_LINE ? &WALKING_LINE : &lines[fileEdges[e].line];
+            adjacency[i].push_back({ { &nodes[fileEdges[e].node], line }, fileEdges[e].weight });
+        }
+    }
+    setNeighbors(adjacency);
+
+    for (int i = 0; i < VALID_LINES; i++) {
+        const NetworkLine& l = fileLines[i];
+        Line& line = lines[i];
+        std::memcpy(line.id, l.id, LINE_ID_SIZE);
+        line.id[LINE_ID_SIZE - 1] = '\0';
+        line.color = l.color;
+        for (int j = 0; j < line.size; j++) {
+            line.path[j] = &nodes[fileStops[line.firstStop + j].node];
+            line.dist[j] = fileStops[line.firstStop + j].dist;
+        }
+    }
+
+    nodeGrid.assign(h->gridRows, std::vector<std::vector<Node*>>(h->gridCols));
+    for (size_t c = 0; c < numCells; c++) {
+        std::vector<Node*>& cell = nodeGrid[c / h->gridCols][c % h->gridCols];
+        for (uint32_t k = gridOffsets[c]; k < gridOffsets[c + 1]; k++) {
+            cell.push_back(&nodes[gridNodes[k]]);
+        }
+    }
+
+    for (int i = 0; i < VALID_TRAINS; i++) {
+        const NetworkTrain& t = fileTrains[i];
+        Train& train = trains[i];
+        train.line = &lines[t.line];
+        train.index = t.index;
+        train.status = STATUS_TRANSFER;
+        train.statusForward = t.statusForward;
+        train.setPosition(train.line->path[t.index]->getPosition());
+    }
+    finalize();
+    return true;
+}
+
+bool network::compile(const char* path, uint64_t checksum) {
+    NetworkHeader h = NetworkHeader();
+    h.magic = NETWORK_MAGIC;
+    h.version = NETWORK_VERSION;
+    h.checksum = checksum;
+    h.numNodes = VALID_NODES;
+    h.numLines = VALID_LINES;
+    h.numTrains = VALID_TRAINS;
+    h.gridRows = NODE_GRID_ROWS;
+    h.gridCols = NODE_GRID_COLS;
+    h.gridRowSize = NODE_GRID_ROW_SIZE;
+    h.gridColSize = NODE_GRID_COL_SIZE;
+    h.totalRidership = totalRidership;
+
+    std::vector<NetworkNode> fileNodes(VALID_NODES);
+    std::vector<uint32_t> edgeOffsets;
+    std::vector<NetworkEdge> fileEdges;
+    for (int i = 0; i < VALID_NODES; i++) {
+        Node& node = nodes[i];
+        NetworkNode& n = fileNodes[i];
+        std::memcpy(n.id, node.id, NODE_ID_SIZE);
+        n.x = node.getPosition().x;
+        n.y = node.getPosition().y;
+        n.ridership = node.ridership;
+        n.numerID = node.numerID;
+        n.gridPos = node.gridPos;
+        n.numLines = node.numLines;
+        edgeOffsets.push_back((uint32_t)fileEdges.size());
+        for (unsigned int j = 0; j < node.numNeighbors; j++) {
+            Line* line = node.neighbors[j].line;
+            NetworkEdge edge = NetworkEdge();
+            edge.node = (uint32_t)(node.neighbors[j].node - nodes);
+            edge.line = line == &WALKING_LINE ? NETWORK_WALK_LINE : (uint32_t)(line - lines);
+            edge.weight = node.weights[j];
+            fileEdges.push_back(edge);
+        }
+    }
+    if (fileEdges.size() > NETWORK_MAX_COUNT) {
+        std::cerr << "Network has too many edges (max " << NETWORK_MAX_COUNT << ")" << std::endl;
+        return false;
+    }
+    edgeOffsets.push_back((uint32_t)fileEdges.size());
+    h.numEdges = (uint32_t)fileEdges.size();
+
+    std::vector<NetworkLine> fileLines(VALID_LINES);
+    std::vector<NetworkStop> fileStops;
+    for (int i = 0; i < VALID_LINES; i++) {
+        Line& line = lines[i];
+        NetworkLine& l = fileLines[i];
+        std::memcpy(l.id, line.id, LINE_ID_SIZE);
+        l.color = line.color;
+        l.size = line.size;
+        for (int j = 0; j < line.size; j++) {
+            fileStops.push_back({ (uint32_t)(line.path[j] - nodes), line.dist[j] });
+        }
+    }
+    h.numStops = (uint32_t)fileStops.size();
+
+    std::vector<uint32_t> gridOffsets;
+    std::vector<uint32_t> gridNodes;
+    for (int i = 0; i < NODE_GRID_ROWS; i++) {
+        for (int j = 0; j < NODE_GRID_COLS; j++) {
+            gridOffsets.push_back((uint32_t)gridNodes.size());
+            for (Node* node : nodeGrid[i][j]) {
+                gridNodes.push_back((uint32_t)(node - nodes));
+            }
+        }
+    }
+    gridOffsets.push_back((uint32_t)gridNodes.size());
+    h.numGridEntries = (uint32_t)gridNodes.size();
+
+    std::vector<NetworkTrain> fileTrains(VALID_TRAINS);
+    for (int i = 0; i < VALID_TRAINS; i++) {
+        NetworkTrain& t = fileTrains[i];
+        t.line = (uint32_t)(trains[i].line - lines);
+        t.index = (uint32_t)trains[i].index;
+        t.statusForward = trains[i].statusForward;
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+    out.write((const char*)&h, sizeof(h));
+    out.write((const char*)fileNodes.data(), fileNodes.size() * sizeof(NetworkNode));
+    out.write((const char*)edgeOffsets.data(), edgeOffsets.size() * sizeof(uint32_t));
+    out.write((const char*)fileEdges.data(), fileEdges.size() * sizeof(NetworkEdge));
+    out.write((const char*)fileLines.data(), fileLines.size() * sizeof(NetworkLine));
+    out.write((const char*)fileStops.data(), fileStops.size() * sizeof(NetworkStop));
+    out.write((const char*)gridOffsets.data(), gridOffsets.size() * sizeof(uint32_t));
+    out.write((const char*)gridNodes.data(), gridNodes.size() * sizeof(uint32_t));
+    out.write((const char*)fileTrains.data(), fileTrains.size() * sizeof(NetworkTrain));
+    return (bool)out;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "macros.h"
+#include "line.h"
+#include "node.h"
+
+constexpr uint32_t NETWORK_MAGIC = 0x4E525343; // "CSRN"
+constexpr uint32_t NETWORK_VERSION = 3;
+constexpr uint32_t NETWORK_WALK_LINE = 0xFFFFFFFF;
+constexpr uint32_t NETWORK_MAX_COUNT = 0x7FFFFFFF; // most nodes, edges, lines, stops or trains (indexed with int in memory, uint32_t on disk)
+
+struct NetworkNode {
+    char id[NODE_ID_SIZE];
+    float x; // normalized window position
+    float y;
+    uint32_t ridership;
+    uint32_t numerID; // always the node's index, load() does not rely on it
+    uint16_t gridPos;
+    uint8_t numLines;
+    uint8_t pad;
+};
+
+// neighbor edge, lines[line] or walking if line is NETWORK_WALK_LINE
+struct NetworkEdge {
+    uint32_t node;
+    uint32_t line;
+    float weight;
+};
+
+// stops are stored separately, line i owns size stops starting after the stops of lines 0..i-1
+struct NetworkLine {
+    char id[LINE_ID_SIZE];
+    LineColor color;
+    uint32_t size;
+};
+
+struct NetworkStop {
+    uint32_t node;
+    float dist;
+};
+
+struct NetworkTrain {
+    uint32_t line;
+    uint32_t index;
+    int8_t statusForward;
+    uint8_t pad[3];
+};
+
+// on-disk layout: header, nodes, numNodes + 1 edge offsets, edges (CSR adjacency in neighbor order), lines, stops,
+// gridRows * gridCols + 1 grid offsets, grid cell contents (node indices), trains
+struct NetworkHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t checksum;
+    uint32_t numNodes;
+    uint32_t numEdges;
+    uint32_t numLines;
+    uint32_t numStops;
+    uint32_t numTrains;
+    uint32_t gridRows;
+    uint32_t gridCols;
+    uint32_t gridRowSize;
+    uint32_t gridColSize;
+    uint32_t numGridEntries;
+    uint32_t totalRidership;
+    uint32_t pad;
+};
+
+// compiled network: everything init() derives from the CSV files, stored as one versioned blob that is mapped and copied into place
+// nodes, lines and trains live in exactly sized arrays, their stops, edges and train slots are carved out of shared pools
+namespace network {
+    // hash of the CSV files and every constant the compiled network depends on, used to reject stale blobs
+    uint64_t sourceChecksum();
+
+    // maps a compiled network and fills the nodes, lines, trains and node grid, returns false if it is missing, stale or damaged
+    bool load(const char* path, uint64_t checksum);
+    // writes the network currently in memory (built from the CSV files) to path
+    bool compile(const char* path, uint64_t checksum);
+
+    // whether a network of this size fits the in-memory and on-disk formats, prints what does not
+    bool fits(size_t numNodes, const std::vector<int>& lineSizes, size_t numTrains);
+    // (re)allocates nodes, lines (with lineSizes[i] stops each), trains and the platform queues
+    void allocate(int numNodes, const std::vector<int>& lineSizes, int numTrains);
+    // packs every node's neighbors (and edge weights) into the shared edge arrays, keeping their order
+    void setNeighbors(const std::vector<std::vector<std::pair<PathWrapper, float>>>& adjacency);
+    // builds line stop indices, train slots and train rider lists once stops and trains are placed
+    void finalize();
+    // permutes nodes into order (one of NODE_ORDER_*) and remaps every reference to them, then finalizes again
+    void renumber(int order);
+    // average distance in nodes[] between the two ends of an edge
+    float meanEdgeSpan();
+}
@@ -1,25 +1,50 @@
+#include <atomic>
 #include <iostream>
 #include "node.h"
+#include "patharena.h"
+#include "pathgraph.h"
+#include "landmarks.h"
 #include "pathcache.h"
+#include "pathfinder.h"
+#include "routetable.h"
+#include "contraction.h"
 
+PathArena paths;
 PathCache cache = PathCache(PATH_CACHE_BUCKETS, PATH_CACHE_BUCKETS_SIZE);
-
-int pathRequests;
-int pathCacheHits;
-int pathFails;
-
-Node::Node() : Drawable(NODE_MIN_SIZE, NODE_N_POINTS) {
+RouteTable routes;
+PathGraph pathGraph; // search graph shared by every engine
+Landmarks landmarks;
+ContractionHierarchy hierarchy;
+std::atomic<int> pathfindingEngine(DEFAULT_PATHFINDING_ENGINE); // selects the search used on route table and cache misses, cycled by the render thread
+thread_local PathfindingContext pathfinder; // per-thread search scratch space
+
+// counters are shared by every thread that looks up paths
+std::atomic<int> pathRequests;
+std::atomic<int> pathSharedHits; // paths already interned by another citizen
+std::atomic<int> pathTableHits;
+std::atomic<int> pathFails;
+std::atomic<unsigned long> pathSearches; // queries that reached a search engine
+std::atomic<unsigned long> pathNodesExpanded; // nodes (or CH states) expanded over all searches
+
+Node::Node() {
+    id[0] = '\0';
+    ridership = 0;
+    capacity = 0;
+    numerID = 0;
+    status = STATUS_DESPAWNED;
+    gridPos = 0;
+    level = 0;
+    totalRiders = 0;
+    numLines = 0;
     numNeighbors = 0;
-    for (int i = 0; i < NODE_N_NEIGHBORS; i++) {
-        neighbors[i] = PathWrapper();
-    }
-    for (int i = 0; i < NODE_N_TRAINS; i++) {
-        trains[i] = nullptr;
-    }
+    numTrainSlots = 0;
+    neighbors = nullptr;
+    weights = nullptr;
+    trains = nullptr;
 }
 
 bool Node::addTrain(Train* train) {
-    for (int i = 0; i < NODE_N_TRAINS; i++) {
+    for (unsigned int i = 0; i < numTrainSlots; i++) {
         if (trains[i] == nullptr) {
             trains[i] = train;
             return true;
@@ -29,7 +54,7 @@ bool Node::addTrain(Train* train) {
 }
 
 bool Node::removeTrain(Train* train) {
-    for (int i = 0; i < NODE_N_TRAINS; i++) {
+    for (unsigned int i = 0; i < numTrainSlots; i++) {
         if (trains[i] == train) {
             trains[i] = nullptr;
             return true;
@@ -38,37 +63,9 @@ bool Node::removeTrain(Train* train) {
     return false;
 }
 
-bool Node::addNeighbor(const PathWrapper& neighbor, float weight) {
-    for (int i = 0; i < NODE_N_NEIGHBORS; i++) {
-        if (neighbors[i].node == neighbor.node && neighbors[i].line == neighbor.line) {
-            return false;
-        }
-        if (neighbors[i].node == nullptr) {
-            neighbors[i] = neighbor;
-            weights[i] = weight;
-            numNeighbors++;
-            return true;
-        }
-    }
-    std::cout << "Too big @" << id << std::endl;
-    return false;
-}
-
-bool Node::removeNeighbor(const PathWrapper& neighbor) {
-    for (int i = 0; i < NODE_N_NEIGHBORS; i++) {
-        if (neighbors[i].node == neighbor.node && neighbors[i].line == neighbor.line) {
-            neighbors[i].node = nullptr;
-            neighbors[i].line = nullptr;
-            numNeighbors--;
-            return true;
-        }
-    }
-    return false;
-}
-
-char Node::numTrains() {
+int Node::numTrains() {
     int c = 0;
-    for (int i = 0; i < NODE_N_TRAINS; i++) {
+    for (unsigned int i = 0; i < numTrainSlots; i++) {
         if (trains[i] != nullptr) {
             c++; // lol, haha! funny!
         }
@@ -76,112 +73,86 @@ char Node::numTrains() {
     return c;
 }
 
-bool Node::findPath(Node* end, PathWrapper* destPath, char* destPathSize) {
+bool Node::bidirectionalAStar(Node* start, Node* end, PathWrapper* destPath, int* destPathSize) {
+    int numTransfers;
+    return pathfinder.bidirectionalAStar(start, end, destPath, destPathSize, &numTransfers);
+}
+
+PathHandle Node::findPath(Node* end) {
     pathRequests++;
-    Node* endCopy = end;
 
-    PathCacheWrapper& cachedPath = cache.get(this, end);
-    if (cachedPath.size > 0) {
-        pathCacheHits++;
-        std::copy(cachedPath.begin(), cachedPath.end(), destPath);
-        *destPathSize = char(cachedPath.size);
-        
-        return true;
+    // another citizen (or the cache) may already hold this path
+    PathHandle h = paths.find(this, end);
+    if (h != NULL_PATH) {
+        pathSharedHits++;
+        return h;
     }
 
-    cachedPath = cache.get(end, this);
-    if (cachedPath.size > 0) {
-        pathCacheHits++;
-        std::reverse_copy(cachedPath.begin(), cachedPath.end(), destPath);
-        *destPathSize = char(cachedPath.size);
-        for (int i = 0; i < cachedPath.size-1; i++) {
-            destPath[i] = destPath[i + 1];
-        }
-        return true;
+    // paths are symmetric, so a cached end -> start path can be reversed
+    h = cache.getReversed(this, end);
+    if (h != NULL_PATH) {
+        return h;
     }
 
-    auto compare = [](Node* a, Node* b) { return a->score > b->score; };
-    std::priority_queue<Node*, std::vector<Node*>, decltype(compare)> queue(compare);
-    std::unordered_set<Node*> queueSet;
-    std::unordered_set<Node*> visited;
-    std::unordered_map<Node*, PathWrapper> from;
-    std::unordered_map<Node*, float> score;
-
-    score[this] = 0.0f;
-    this->score = score[this] + dist(end) * DISTANCE_SCALE;
-    queue.push(this);
-    queueSet.insert(this);
-    while (!queue.empty()) {
-        Node* current = queue.top();
-        queue.pop();
-        queueSet.erase(current);
-
-        if (current == end) {
-            // path found, postprocess and return
-            std::vector<PathWrapper> path;
-            int numTransfers = 0;
-            Line* prevLine = nullptr;
-            while (from.find(end) != from.end()) {
-                PathWrapper pathWrapper = from[end];
-                if (pathWrapper.line != prevLine) {
-                    prevLine = pathWrapper.line;
-                    numTransfers++;
-                    // would be possible to contract paths only to lines, but creates lots of issues and does not improve performance
-                    // would, however, have high impact on memory
-                }
-                path.push_back(pathWrapper);
-                end = pathWrapper.node;
-            }
-            std::reverse(path.begin(), path.end());
-            path.push_back(PathWrapper{ endCopy, path.back().line });
-
-            size_t pathSize = path.size();
-            if (pathSize > CITIZEN_PATH_SIZE) {
-                // cosplaying as someone who cares about memory safety
-                #if PATHFINDER_ERRORS == true
-                std::cout << "ERR: encountered large path (" << pathSize << ") [" << this->id << " : " << end->id << " ]" << std::endl;
-                #endif
-                pathFails++;
-                return false;
-            }
-
-            std::copy(path.begin(), path.end(), destPath);
-            *destPathSize = (char)pathSize;
+    PathLeg* legs = pathfinder.legBuffer();
+    int numLegs;
+    int numTransfers;
+    if (!computePath(end, legs, &numLegs, &numTransfers)) {
+        pathFails++;
+        return NULL_PATH;
+    }
 
-            if (numTransfers >= CACHE_TRANSFERS_THRESHOLD) {
-                cache.put(this, endCopy, destPath, pathSize);
-            }
+    h = paths.intern(this, end, legs, numLegs);
+    // every arena slot is taken
+    if (h == NULL_PATH) {
+        pathFails++;
+        return NULL_PATH;
+    }
+    if (numTransfers >= CACHE_TRANSFERS_THRESHOLD) {
+        cache.put(this, end, h);
+    }
+    return h;
+}
 
+bool Node::computePath(Node* end, PathLeg* destLegs, int* numLegs, int* numTransfers) {
+    // the route table covers every OD pair, so there is nothing to search for if it is loaded
+    if (routes.loaded()) {
+        if (routes.get(this, end, destLegs, numLegs) && *numLegs <= PATH_MAX_LEGS) {
+            pathTableHits++;
+            *numTransfers = *numLegs;
             return true;
         }
+        return false;
+    }
 
-        visited.insert(current);
-
-        for (int i = 0; i < current->numNeighbors; i++) {
-            Node* neighbor = current->neighbors[i].node;
-            if (neighbor == nullptr) continue;
-            Line* line = current->neighbors[i].line;
-
-            if (visited.find(neighbor) != visited.end()) continue;
-
-            float aggregateScore = score[current] + current->weights[i];
-
-            if (from[neighbor].line != line) {
-                aggregateScore += TRANSFER_PENALTY;
-            }
-
-            if (aggregateScore < score[neighbor] || queueSet.find(neighbor) == queueSet.end()) {
-                from[neighbor] = PathWrapper{ current, line };
-                score[neighbor] = aggregateScore;
-                neighbor->score = aggregateScore + neighbor->dist(end) * DISTANCE_SCALE;
-
-                if (queueSet.find(neighbor) == queueSet.end()) {
-                    queue.push(neighbor);
-                    queueSet.insert(neighbor);
-                }
-            }
-        }
+    PathWrapper* destPath = pathfinder.pathBuffer();
+    int destPathSize;
+
+    // read once so a switch mid-query cannot mix engines
+    int engine = pathfindingEngine.load(std::memory_order_relaxed);
+    prepareEngine(engine);
+    bool found;
+    unsigned int expanded;
+    if (engine == PATHFINDING_ENGINE_CH && hierarchy.built()) {
+        found = hierarchy.query(this, end, destPath, &destPathSize, numTransfers);
+        expanded = hierarchy.expanded();
     }
-    pathFails++;
-    return false; // no path found
-}
\ No newline at end of file
+    else if (engine == PATHFINDING_ENGINE_BIDIRECTIONAL) {
+        found = pathfinder.bidirectionalAStar(this, end, destPath, &destPathSize, numTransfers);
+        expanded = pathfinder.expanded;
+    }
+    else if (engine == PATHFINDING_ENGINE_ALT && landmarks.built()) {
+        found = pathfinder.altAStar(this, end, destPath, &destPathSize, numTransfers);
+        expanded = pathfinder.expanded;
+    }
+    else {
+        found = pathfinder.aStar(this, end, destPath, &destPathSize, numTransfers);
+        expanded = pathfinder.expanded;
+    }
+    pathSearches++;
+    pathNodesExpanded += expanded;
+    if (found) {
+        *numLegs = compressPath(destPath, destPathSize, destLegs);
+    }
+    return found && *numLegs <= PATH_MAX_LEGS;
+}
@@ -1,13 +1,10 @@
 #pragma once
 
-#include <SFML/Graphics.hpp>
 #include <algorithm>
 #include <queue>
 #include <vector>
-#include <unordered_map>
-#include <unordered_set>
 #include "macros.h"
-#include "drawable.h"
+#include "geometry.h"
 #include "line.h"
 
 class Train;
@@ -18,29 +15,45 @@ struct PathWrapper {
     Line* line;
 };
 
-class Node : public Drawable {
+// one leg of a path: ride line from board to alight, or walk if line is &WALKING_LINE
+struct PathLeg {
+    Node* board;
+    Node* alight;
+    Line* line;
+    unsigned int boardInd; // stop indices in line->path, 0 for walks
+    unsigned int alightInd;
+
+    // PLATFORM_FORWARD if the leg rides towards increasing stop indices
+    inline int direction() const {
+        return alightInd > boardInd ? PLATFORM_FORWARD : PLATFORM_BACKWARD;
+    }
+};
+
+// reference to an interned path in the PathArena (see patharena.h)
+typedef unsigned int PathHandle;
+constexpr PathHandle NULL_PATH = 0xFFFFFFFF;
+
+class Node : public Positioned {
 public:
     char id[NODE_ID_SIZE];
     unsigned int ridership;
-    unsigned int capacity;
-    unsigned short int numerID;
-    char numNeighbors;
+    unsigned int capacity; // citizens walking through the station or waiting on a platform, updated at the tick barrier and by boarding
+    unsigned int numerID; // index in nodes
+    unsigned int numNeighbors;
     char status;
-    float score;
     unsigned short int gridPos;
     unsigned short int level;
     unsigned long int totalRiders;
-    char numLines;
-    PathWrapper neighbors[NODE_N_NEIGHBORS];
-    float weights[NODE_N_NEIGHBORS];
-    Train* trains[NODE_N_TRAINS];
+    unsigned char numLines;
+    unsigned int numTrainSlots;
+    PathWrapper* neighbors; // numNeighbors edges in the network's shared edge arrays (see network.h)
+    float* weights;
+    Train** trains; // one slot for every train whose line serves this node, so a train can always stop
 
     Node();
 
     bool addTrain(Train* train);
     bool removeTrain(Train* train);
-    bool addNeighbor(const PathWrapper& neighbor, float weight);
-    bool removeNeighbor(const PathWrapper& neighbor);
 
     inline void setGridPos(char x, char y) {
         gridPos = x << 8 | y;
@@ -67,8 +80,12 @@ public:
         char y = gridY();
         return y < NODE_GRID_COLS - 1 ? y + 1 : y;
     }
-    char numTrains();
+    int numTrains();
 
-    static std::vector<PathWrapper> bidirectionalAStar(Node* start, Node* end);
-    bool findPath(Node* end, PathWrapper* destPath, char* destPathSize);
+    static bool bidirectionalAStar(Node* start, Node* end, PathWrapper* destPath, int* destPathSize);
+    // returns a reference to the shared path to end (release it with PathArena::release), or NULL_PATH
+    PathHandle findPath(Node* end);
+private:
+    // looks the path up in the route table or runs the selected search engine
+    bool computePath(Node* end, PathLeg* destLegs, int* numLegs, int* numTransfers);
 };
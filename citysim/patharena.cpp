@@ -0,0 +1,161 @@
+#include "patharena.h"
+#include <algorithm>
+
+PathArena::PathArena() {
+    chunks = new std::atomic<SharedPath*>[PATH_ARENA_MAX_CHUNKS];
+    for (int i = 0; i < PATH_ARENA_MAX_CHUNKS; i++) {
+        chunks[i] = nullptr;
+    }
+    for (Shard& shard : shards) {
+        shard.keys.assign(PATH_ARENA_SHARD_CAPACITY, NO_KEY);
+        shard.handles.assign(PATH_ARENA_SHARD_CAPACITY, NULL_PATH);
+        shard.numKeys = 0;
+    }
+    usedSlots = 0;
+    livePaths = 0;
+    liveBytes = 0;
+}
+
+PathArena::~PathArena() {
+    for (PathHandle h = 0; h < usedSlots; h++) {
+        delete[] slot(h).legs;
+    }
+    for (int i = 0; i < PATH_ARENA_MAX_CHUNKS; i++) {
+        delete[] chunks[i].load();
+    }
+    delete[] chunks;
+}
+
+void PathArena::grow(Shard& shard) {
+    std::vector<uint64_t> keys(shard.keys.size() * 2, NO_KEY);
+    std::vector<PathHandle> handles(shard.handles.size() * 2, NULL_PATH);
+    keys.swap(shard.keys);
+    handles.swap(shard.handles);
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (keys[i] == NO_KEY) continue;
+        size_t e = probe(shard, keys[i]);
+        shard.keys[e] = keys[i];
+        shard.handles[e] = handles[i];
+    }
+}
+
+void PathArena::erase(Shard& shard, size_t i) {
+    size_t mask = shard.keys.size() - 1;
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (shard.keys[j] == NO_KEY) break;
+        // entry j can fill the hole unless its home slot lies cyclically in (i, j]
+        size_t home = (hashOf(shard.keys[j]) >> 12) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            shard.keys[i] = shard.keys[j];
+            shard.handles[i] = shard.handles[j];
+            i = j;
+        }
+    }
+    shard.keys[i] = NO_KEY;
+    shard.handles[i] = NULL_PATH;
+    shard.numKeys--;
+}
+
+PathHandle PathArena::allocSlot() {
+    std::lock_guard<std::mutex> lock(slotLock);
+    if (!freeSlots.empty()) {
+        PathHandle h = freeSlots.back();
+        freeSlots.pop_back();
+        return h;
+    }
+    size_t chunk = usedSlots >> PATH_ARENA_CHUNK_BITS;
+    if (chunk >= PATH_ARENA_MAX_CHUNKS) {
+        return NULL_PATH;
+    }
+    if (chunks[chunk].load(std::memory_order_relaxed) == nullptr) {
+        SharedPath* slots = new SharedPath[PATH_ARENA_CHUNK_SIZE];
+        for (int i = 0; i < PATH_ARENA_CHUNK_SIZE; i++) {
+            slots[i].refs = 0;
+            slots[i].size = 0;
+            slots[i].legs = nullptr;
+            slots[i].key = 0;
+        }
+        chunks[chunk].store(slots, std::memory_order_release);
+    }
+    return usedSlots++;
+}
+
+void PathArena::freeSlot(PathHandle h) {
+    std::lock_guard<std::mutex> lock(slotLock);
+    freeSlots.push_back(h);
+}
+
+PathHandle PathArena::find(Node* start, Node* end) {
+    uint64_t key = keyOf(start, end);
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    // mapped paths always have a reference, and cannot lose their last one while the lock is held
+    PathHandle h = shard.handles[probe(shard, key)];
+    if (h != NULL_PATH) {
+        slot(h).refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return h;
+}
+
+PathHandle PathArena::intern(Node* start, Node* end, const PathLeg* legs, int size) {
+    uint64_t key = keyOf(start, end);
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.lock);
+
+    size_t e = probe(shard, key);
+    PathHandle h = shard.handles[e];
+    if (h != NULL_PATH) {
+        slot(h).refs.fetch_add(1, std::memory_order_relaxed);
+        return h;
+    }
+
+    h = allocSlot();
+    if (h == NULL_PATH) return NULL_PATH;
+    shard.keys[e] = key;
+    shard.handles[e] = h;
+    if (++shard.numKeys * 2 > shard.keys.size()) {
+        grow(shard);
+    }
+
+    SharedPath& s = slot(h);
+    s.key = key;
+    s.legs = new PathLeg[size];
+    std::copy(legs, legs + size, s.legs);
+    s.size = size;
+    s.refs.store(1, std::memory_order_release);
+    livePaths++;
+    liveBytes += sizeof(PathLeg) * size;
+    return h;
+}
+
+void PathArena::acquire(PathHandle h) {
+    if (h == NULL_PATH) return;
+    slot(h).refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PathArena::release(PathHandle h) {
+    if (h == NULL_PATH) return;
+    SharedPath& s = slot(h);
+    int refs = s.refs.load(std::memory_order_relaxed);
+    while (refs > 1) {
+        if (s.refs.compare_exchange_weak(refs, refs - 1, std::memory_order_acq_rel)) {
+            return;
+        }
+    }
+
+    // possibly the last reference, which only goes away under the lock (our reference keeps key from changing)
+    Shard& shard = shardOf(s.key);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    if (s.refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    erase(shard, probe(shard, s.key));
+    livePaths--;
+    liveBytes -= sizeof(PathLeg) * s.size;
+    delete[] s.legs;
+    s.legs = nullptr;
+    s.size = 0;
+    freeSlot(h);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "macros.h"
+#include "node.h"
+
+// interned, immutable path shared by every holder of its handle
+struct SharedPath {
+    std::atomic<int> refs; // 0 when the slot holds no path
+    int size; // number of legs
+    PathLeg* legs;
+    uint64_t key; // (start, end) pair, fixed while the slot holds a path
+};
+
+// reference-counted storage for paths, at most one live path per (start, end) pair
+// pairs are looked up in PATH_ARENA_SHARDS hash tables with their own locks, a pair holds a slot while its path is live
+// paths only go between 0 and 1 references under their shard's lock, the last release frees the legs and returns the slot
+// slots live in chunks that never move, so legs() and size() need no lock
+// handles returned by find/intern/acquire must be given back with release()
+class PathArena {
+public:
+    PathArena();
+    ~PathArena();
+
+    // returns a new reference to the live start -> end path, or NULL_PATH if there is none
+    PathHandle find(Node* start, Node* end);
+    // copies legs into the arena unless a start -> end path is already live, returns a new reference either way
+    // (NULL_PATH if every slot is taken)
+    PathHandle intern(Node* start, Node* end, const PathLeg* legs, int size);
+    // both ignore NULL_PATH
+    void acquire(PathHandle h);
+    // frees the path and its slot once its last reference is released
+    void release(PathHandle h);
+
+    inline const PathLeg* legs(PathHandle h) {
+        return slot(h).legs;
+    }
+    inline int size(PathHandle h) {
+        return slot(h).size;
+    }
+    inline unsigned int live() {
+        return livePaths;
+    }
+    inline unsigned long bytes() {
+        return liveBytes;
+    }
+private:
+    // open addressing with linear probing, pairs are removed with their last reference
+    struct alignas(64) Shard {
+        std::mutex lock; // serializes paths of this shard going between 0 and 1 references
+        std::vector<uint64_t> keys; // every pair with a live path, NO_KEY in empty entries
+        std::vector<PathHandle> handles;
+        size_t numKeys;
+    };
+    static constexpr uint64_t NO_KEY = ~0ull;
+
+    Shard shards[PATH_ARENA_SHARDS];
+    std::atomic<SharedPath*>* chunks;
+    std::mutex slotLock; // chunk allocation and free slots
+    PathHandle usedSlots;
+    std::vector<PathHandle> freeSlots;
+    std::atomic<unsigned int> livePaths;
+    std::atomic<unsigned long> liveBytes;
+
+    inline SharedPath& slot(PathHandle h) {
+        return chunks[h >> PATH_ARENA_CHUNK_BITS].load(std::memory_order_acquire)[h & (PATH_ARENA_CHUNK_SIZE - 1)];
+    }
+    static inline uint64_t keyOf(Node* start, Node* end) {
+        return uint64_t(start->numerID) << 32 | end->numerID;
+    }
+    static inline uint64_t hashOf(uint64_t key) {
+        return key * 0x9E3779B97F4A7C15ull;
+    }
+    inline Shard& shardOf(uint64_t key) {
+        return shards[(hashOf(key) >> 32) % PATH_ARENA_SHARDS];
+    }
+    // entry holding key, or the empty entry it would be inserted at
+    static inline size_t probe(const Shard& shard, uint64_t key) {
+        size_t mask = shard.keys.size() - 1;
+        size_t i = (hashOf(key) >> 12) & mask;
+        while (shard.keys[i] != key && shard.keys[i] != NO_KEY) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+    static void grow(Shard& shard);
+    // empties entry i, moving later entries of its probe run back so lookups never stop early
+    static void erase(Shard& shard, size_t i);
+    PathHandle allocSlot();
+    void freeSlot(PathHandle h);
+};
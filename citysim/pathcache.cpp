@@ -1,93 +1,105 @@
 #include "pathcache.h"
-#include <iostream>
+#include <algorithm>
+#include <vector>
 
-PathCacheWrapper NULL_WRAPPER;
+extern PathArena paths;
 
 PathCacheWrapper::PathCacheWrapper() {
     startNode = nullptr;
     endNode = nullptr;
-    memset(path, 0, sizeof(PathWrapper) * CITIZEN_PATH_SIZE);
-    size = -1;
-    lru = -1;
-}
-
-PathCacheWrapper::PathCacheWrapper(Node* st, Node* e, PathWrapper* p, int s) {
-    set(st, e, p, s, -1);
-}
-
-void PathCacheWrapper::set(Node* st, Node* e, PathWrapper* p, int s, int l) {
-    std::copy(p, p + s, path);
-
-    startNode = st;
-    endNode = e;
-    size = s;
-    lru = l;
-}
-
-PathWrapper* PathCacheWrapper::begin() {
-    return &path[0];
-}
-
-PathWrapper* PathCacheWrapper::end() {
-    return &path[last()];
-}
-
-int PathCacheWrapper::last() {
-    return size - 1;
+    path = NULL_PATH;
+    lastUsed = 0;
 }
 
 PathCache::PathCache(size_t numBuckets, size_t bucketSize) {
     cache = new PathCacheWrapper[numBuckets * bucketSize];
+    bucketLocks = new std::mutex[numBuckets];
+    bucketClocks = new unsigned int[numBuckets]();
     NUM_BUCKETS = numBuckets;
     BUCKET_SIZE = bucketSize;
+    hitCount = 0;
+    missCount = 0;
+    evictionCount = 0;
 }
 
 PathCache::~PathCache() {
-    delete(cache);
+    delete[] cache;
+    delete[] bucketLocks;
+    delete[] bucketClocks;
+}
+
+void PathCache::resetStats() {
+    hitCount = 0;
+    missCount = 0;
+    evictionCount = 0;
 }
 
 // returns true if a cache entry was evicted
-bool PathCache::put(Node* start, Node* end, PathWrapper* p, int s) {
-    int bucket = (start->numerID * PRIME_1 + end->numerID * PRIME_2) % NUM_BUCKETS;
-    int bucketInd = bucket * BUCKET_SIZE;
-    int maxLRU = -1;
-    int maxInd = 0;
-    for (int i = 0; i < BUCKET_SIZE; i++) {
-        int ind = bucketInd + i;
-        cache[ind].lru++;
-        int lru = cache[ind].lru;
+bool PathCache::put(Node* start, Node* end, PathHandle path) {
+    size_t bucket = bucketOf(start, end);
+    size_t bucketInd = bucket * BUCKET_SIZE;
+    std::lock_guard<std::mutex> bucketLock(bucketLocks[bucket]);
+
+    // reuse the least recently used slot (empty slots have never been used)
+    size_t lruInd = bucketInd;
+    for (size_t i = 0; i < BUCKET_SIZE; i++) {
+        size_t ind = bucketInd + i;
         if (cache[ind].startNode == start && cache[ind].endNode == end) {
             return false;
         }
-        if (lru == -1) {
-            cache[ind].set(start, end, p, s, 0);
-            return false;
-        }
-        if (lru > maxLRU) {
-            maxLRU = lru;
-            maxInd = ind;
+        if (cache[ind].lastUsed < cache[lruInd].lastUsed) {
+            lruInd = ind;
         }
     }
-    cache[maxInd].set(start, end, p, s, 0);
-    return true;
+    PathCacheWrapper& entry = cache[lruInd];
+    bool evicted = entry.lastUsed != 0;
+    if (evicted) {
+        paths.release(entry.path);
+        evictionCount++;
+    }
+    paths.acquire(path);
+    entry.startNode = start;
+    entry.endNode = end;
+    entry.path = path;
+    entry.lastUsed = ++bucketClocks[bucket];
+    return evicted;
 }
 
-PathCacheWrapper& PathCache::get(Node* start, Node* end) {
-    int bucket = (start->numerID * PRIME_1 + end->numerID * PRIME_2) % NUM_BUCKETS;
-    int bucketInd = bucket * BUCKET_SIZE;
-    for (int i = 0; i < BUCKET_SIZE; i++) {
-        int ind = bucketInd + i;
-        cache[ind].lru++;
-        if (cache[ind].startNode == start && cache[ind].endNode == end) {
-            cache[ind].lru = 0;
-            for (int j = i + 1; j < BUCKET_SIZE; j++) {
-                cache[bucketInd + j].lru++;
+PathHandle PathCache::findReversed(Node* start, Node* end) {
+    size_t bucket = bucketOf(start, end);
+    size_t bucketInd = bucket * BUCKET_SIZE;
+    std::lock_guard<std::mutex> bucketLock(bucketLocks[bucket]);
+    for (size_t i = 0; i < BUCKET_SIZE; i++) {
+        PathCacheWrapper& entry = cache[bucketInd + i];
+        if (entry.startNode == start && entry.endNode == end) {
+            entry.lastUsed = ++bucketClocks[bucket];
+
+            // paths are symmetric: the reverse rides each leg back in the opposite order
+            // (the entry's reference keeps the path alive while the bucket is locked)
+            const PathLeg* legs = paths.legs(entry.path);
+            int size = paths.size(entry.path);
+            std::vector<PathLeg> reversedLegs(size);
+            for (int j = 0; j < size; j++) {
+                const PathLeg& leg = legs[size - 1 - j];
+                reversedLegs[j] = PathLeg{ leg.alight, leg.board, leg.line, leg.alightInd, leg.boardInd };
             }
-            return cache[ind];
+            return paths.intern(end, start, reversedLegs.data(), size);
         }
     }
-
-    NULL_WRAPPER.size = 0; // because somehow this mf is getting updated... that's probably an issue
-    return NULL_WRAPPER;
+    return NULL_PATH;
 }
 
+PathHandle PathCache::getReversed(Node* start, Node* end) {
+    PathHandle h = NULL_PATH;
+    #if DETERMINISTIC_MODE == false
+    // deterministic mode skips reverse hits: a reversed path can differ from what a search in this direction finds
+    h = findReversed(end, start);
+    #endif
+    if (h == NULL_PATH) {
+        missCount++;
+    }
+    else {
+        hitCount++;
+    }
+    return h;
+}
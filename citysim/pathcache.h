@@ -1,33 +1,56 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include "node.h"
+#include "patharena.h"
 
 struct PathCacheWrapper {
     Node* startNode;
     Node* endNode;
-    int size;
-    int lru;
-    PathWrapper path[CITIZEN_PATH_SIZE];
+    PathHandle path; // the cache holds one reference to the interned path
+    unsigned int lastUsed; // bucket clock value of the last access, 0 if the entry is empty
 
     PathCacheWrapper();
-    PathCacheWrapper(Node* st, Node* e, PathWrapper* p, int s);
-
-    void set(Node* st, Node* e, PathWrapper* p, int s, int l);
-
-    PathWrapper* begin();
-    PathWrapper* end();
-    int last();
 };
 
+// keeps frequently used paths interned in the PathArena after their last rider despawns, so PathArena::find keeps hitting them
+// lookups only serve the reverse direction: a cached start -> end path is always found in the arena first
+// each bucket is guarded by its own lock, so any number of threads can share the cache
 class PathCache {
 public:
     PathCache(size_t numBuckets, size_t bucketSize);
     ~PathCache();
 
-    bool put(Node* start, Node* end, PathWrapper* p, int s);
-    PathCacheWrapper& get(Node* start, Node* end);
+    // takes a reference to path, returns true if a cache entry was evicted
+    bool put(Node* start, Node* end, PathHandle path);
+    // returns a new reference to the path start -> end interned from a cached end -> start path, or NULL_PATH
+    PathHandle getReversed(Node* start, Node* end);
+
+    // reverse-direction hits
+    inline unsigned long hits() {
+        return hitCount;
+    }
+    inline unsigned long misses() {
+        return missCount;
+    }
+    inline unsigned long evictions() {
+        return evictionCount;
+    }
+    void resetStats();
 private:
     PathCacheWrapper* cache;
+    std::mutex* bucketLocks;
+    unsigned int* bucketClocks;
     size_t NUM_BUCKETS;
     size_t BUCKET_SIZE;
+    std::atomic<unsigned long> hitCount;
+    std::atomic<unsigned long> missCount;
+    std::atomic<unsigned long> evictionCount;
+
+    inline size_t bucketOf(Node* start, Node* end) {
+        return (start->numerID * PRIME_1 + end->numerID * PRIME_2) % NUM_BUCKETS;
+    }
+    // interns the reverse of the start -> end entry and returns a reference to it, or NULL_PATH if there is none
+    PathHandle findReversed(Node* start, Node* end);
 };
@@ -0,0 +1,356 @@
+#include <cfloat>
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+#include <mutex>
+#include "pathfinder.h"
+#include "landmarks.h"
+#include "contraction.h"
+
+extern Node* nodes;
+extern int VALID_NODES;
+extern Line WALKING_LINE;
+extern PathGraph pathGraph;
+extern Landmarks landmarks;
+extern ContractionHierarchy hierarchy;
+
+static std::once_flag hierarchyOnce;
+static std::once_flag landmarksOnce;
+
+int countTransfers(const PathWrapper* path, int pathSize) {
+    int transfers = 0;
+    Line* prevLine = nullptr;
+    for (int i = 0; i < pathSize - 1; i++) {
+        if (path[i].line != prevLine) {
+            prevLine = path[i].line;
+            transfers++;
+        }
+    }
+    return transfers;
+}
+
+int compressPath(const PathWrapper* path, int pathSize, PathLeg* destLegs) {
+    int numLegs = 0;
+    int k = 0;
+    while (k < pathSize - 1) {
+        Line* line = path[k].line;
+        int j = k;
+        // walking edges connect arbitrary nearby stations, so every walk is its own leg
+        if (line != &WALKING_LINE) {
+            while (j + 1 < pathSize - 1 && path[j + 1].line == line) j++;
+        }
+        PathLeg leg = PathLeg{ path[k].node, path[j + 1].node, line, 0, 0 };
+        if (line != &WALKING_LINE) {
+            leg.boardInd = (unsigned int)line->stopIndex(path[k].node, path[k + 1].node);
+            leg.alightInd = (unsigned int)line->stopIndex(path[j + 1].node, path[j].node);
+        }
+        destLegs[numLegs++] = leg;
+        k = j + 1;
+    }
+    return numLegs;
+}
+
+float pathCost(const PathWrapper* path, int pathSize) {
+    float cost = 0.0f;
+    Line* arrivingLine = nullptr;
+    for (int i = 0; i < pathSize - 1; i++) {
+        Node* node = path[i].node;
+        for (unsigned int j = 0; j < node->numNeighbors; j++) {
+            if (node->neighbors[j].node == path[i + 1].node && node->neighbors[j].line == path[i].line) {
+                cost += edgeCost(node->weights[j], arrivingLine, path[i].line);
+                break;
+            }
+        }
+        arrivingLine = path[i].line;
+    }
+    return cost;
+}
+
+void prepareEngine(int engine) {
+    if (engine == PATHFINDING_ENGINE_CH) {
+        std::call_once(hierarchyOnce, [] {
+            double start = double(clock());
+            hierarchy.build();
+            std::cout << "Contracted " << hierarchy.numStates() << " pathfinding states with " << hierarchy.numShortcuts() << " shortcuts (" << (double(clock()) - start) / CLOCKS_PER_SEC << "s)" << std::endl;
+        });
+    }
+    else if (engine == PATHFINDING_ENGINE_ALT) {
+        std::call_once(landmarksOnce, [] {
+            double start = double(clock());
+            landmarks.build(ALT_LANDMARKS);
+            std::cout << "Solved " << landmarks.size() << " ALT landmark cost tables (" << (double(clock()) - start) / CLOCKS_PER_SEC * 1000 << "ms)" << std::endl;
+        });
+    }
+}
+
+NodeHeap::NodeHeap(size_t numNodes) : heap(numNodes), pos(numNodes), keys(numNodes) {
+    size = 0;
+}
+
+void NodeHeap::push(unsigned int id, float key) {
+    heap[size] = id;
+    pos[id] = size;
+    keys[id] = key;
+    siftUp(size++);
+}
+
+void NodeHeap::decreaseKey(unsigned int id, float key) {
+    keys[id] = key;
+    siftUp(pos[id]);
+}
+
+unsigned int NodeHeap::pop() {
+    unsigned int id = heap[0];
+    if (--size > 0) {
+        heap[0] = heap[size];
+        pos[heap[0]] = 0;
+        siftDown(0);
+    }
+    return id;
+}
+
+void NodeHeap::siftUp(int i) {
+    unsigned int id = heap[i];
+    float key = keys[id];
+    while (i > 0) {
+        int parent = (i - 1) >> 1;
+        if (keys[heap[parent]] <= key) break;
+        heap[i] = heap[parent];
+        pos[heap[i]] = i;
+        i = parent;
+    }
+    heap[i] = id;
+    pos[id] = i;
+}
+
+void NodeHeap::siftDown(int i) {
+    unsigned int id = heap[i];
+    float key = keys[id];
+    while (true) {
+        int child = 2 * i + 1;
+        if (child >= size) break;
+        if (child + 1 < size && keys[heap[child + 1]] < keys[heap[child]]) child++;
+        if (keys[heap[child]] >= key) break;
+        heap[i] = heap[child];
+        pos[heap[i]] = i;
+        i = child;
+    }
+    heap[i] = id;
+    pos[id] = i;
+}
+
+PathfindingContext::PathfindingContext() : stops(VALID_NODES), legs(VALID_NODES) {
+    generation = 0;
+    expanded = 0;
+    for (int d = 0; d < 2; d++) {
+        reached[d].assign(VALID_NODES, 0);
+        closed[d].assign(VALID_NODES, 0);
+        score[d].resize(VALID_NODES);
+        from[d].resize(VALID_NODES);
+        queue[d] = NodeHeap(VALID_NODES);
+    }
+}
+
+void PathfindingContext::nextGeneration() {
+    // on wraparound, stale stamps could collide with the new generation
+    if (++generation == 0) {
+        for (int d = 0; d < 2; d++) {
+            std::fill(reached[d].begin(), reached[d].end(), 0);
+            std::fill(closed[d].begin(), closed[d].end(), 0);
+        }
+        generation = 1;
+    }
+    queue[0].clear();
+    queue[1].clear();
+    expanded = 0;
+}
+
+template<class Estimate>
+bool PathfindingContext::bestFirst(Node* start, Node* end, PathWrapper* destPath, int* destPathSize, int* numTransfers, Estimate estimate, bool reopen) {
+    nextGeneration();
+
+    uint32_t startID = start->numerID;
+    uint32_t endID = end->numerID;
+    reached[0][startID] = generation;
+    score[0][startID] = 0.0f;
+    from[0][startID] = SearchLink{ GRAPH_NO_NODE, GRAPH_NO_LINE };
+    queue[0].push(startID, estimate(startID));
+
+    while (!queue[0].empty()) {
+        uint32_t currentID = queue[0].pop();
+
+        if (currentID == endID) {
+            return reconstruct(startID, endID, endID, destPath, destPathSize, numTransfers);
+        }
+
+        expanded++;
+        closed[0][currentID] = generation;
+        float currentScore = score[0][currentID];
+        uint32_t arrivingLine = from[0][currentID].line;
+
+        for (uint32_t e = pathGraph.firstEdge(currentID); e < pathGraph.lastEdge(currentID); e++) {
+            const GraphEdge& edge = pathGraph.edge(e);
+            uint32_t neighborID = edge.node;
+            bool isClosed = closed[0][neighborID] == generation;
+            if (isClosed && !reopen) continue;
+
+            float aggregateScore = currentScore + edgeCost(edge.weight, arrivingLine, edge.line);
+
+            if (reached[0][neighborID] != generation) {
+                reached[0][neighborID] = generation;
+                score[0][neighborID] = aggregateScore;
+                from[0][neighborID] = SearchLink{ currentID, edge.line };
+                queue[0].push(neighborID, aggregateScore + estimate(neighborID));
+            }
+            else if (aggregateScore < score[0][neighborID]) {
+                score[0][neighborID] = aggregateScore;
+                from[0][neighborID] = SearchLink{ currentID, edge.line };
+                if (isClosed) {
+                    closed[0][neighborID] = 0;
+                    queue[0].push(neighborID, aggregateScore + estimate(neighborID));
+                }
+                else {
+                    queue[0].decreaseKey(neighborID, aggregateScore + estimate(neighborID));
+                }
+            }
+        }
+    }
+    return false; // no path found
+}
+
+bool PathfindingContext::aStar(Node* start, Node* end, PathWrapper* destPath, int* destPathSize, int* numTransfers) {
+    uint32_t endID = end->numerID;
+    return bestFirst(start, end, destPath, destPathSize, numTransfers, [endID](uint32_t n) {
+        return pathGraph.estimate(n, endID);
+    }, false);
+}
+
+bool PathfindingContext::altAStar(Node* start, Node* end, PathWrapper* destPath, int* destPathSize, int* numTransfers) {
+    uint32_t endID = end->numerID;
+    return bestFirst(start, end, destPath, destPathSize, numTransfers, [endID](uint32_t n) {
+        return std::max(pathGraph.estimate(n, endID), landmarks.estimate(n, endID));
+    }, true);
+}
+
+// penalty for joining a forward label (arriving line) with a backward label (leaving line) at the same node
+// the end node leaves on no line, so nothing is charged there
+static inline float joinPenalty(uint32_t arrivingLine, uint32_t leavingLine) {
+    return (leavingLine == GRAPH_NO_LINE || arrivingLine == leavingLine) ? 0.0f : TRANSFER_PENALTY;
+}
+
+bool PathfindingContext::bidirectionalAStar(Node* start, Node* end, PathWrapper* destPath, int* destPathSize, int* numTransfers) {
+    nextGeneration();
+
+    // averaged potentials keep both searches consistent: forward keys use +p(v), backward keys -p(v)
+    uint32_t startID = start->numerID;
+    uint32_t endID = end->numerID;
+    auto potential = [startID, endID](uint32_t n) {
+        return (pathGraph.estimate(n, endID) - pathGraph.estimate(n, startID)) * 0.5f;
+    };
+
+    uint32_t endpoints[2] = { startID, endID };
+    for (int d = 0; d < 2; d++) {
+        uint32_t id = endpoints[d];
+        reached[d][id] = generation;
+        score[d][id] = 0.0f;
+        from[d][id] = SearchLink{ GRAPH_NO_NODE, GRAPH_NO_LINE };
+        queue[d].push(id, d == 0 ? potential(id) : -potential(id));
+    }
+
+    float best = FLT_MAX;
+    uint32_t meet = GRAPH_NO_NODE;
+    while (!queue[0].empty() && !queue[1].empty()) {
+        float topForward = queue[0].topKey();
+        float topBackward = queue[1].topKey();
+        if (topForward + topBackward >= best) break;
+
+        int d = topForward <= topBackward ? 0 : 1;
+        uint32_t currentID = queue[d].pop();
+        expanded++;
+        closed[d][currentID] = generation;
+        float currentScore = score[d][currentID];
+        uint32_t currentLine = from[d][currentID].line;
+
+        for (uint32_t e = pathGraph.firstEdge(currentID); e < pathGraph.lastEdge(currentID); e++) {
+            const GraphEdge& edge = pathGraph.edge(e);
+            uint32_t neighborID = edge.node;
+            if (closed[d][neighborID] == generation) continue;
+
+            // edges are symmetric, so the backward search can walk neighbors too
+            // forward charges a line change on the later edge, backward on the earlier one
+            uint32_t line = edge.line;
+            float aggregateScore = currentScore + edge.weight;
+            if (d == 0) {
+                aggregateScore += line == currentLine ? 0.0f : TRANSFER_PENALTY;
+            }
+            else {
+                aggregateScore += joinPenalty(line, currentLine);
+            }
+
+            bool improved = false;
+            if (reached[d][neighborID] != generation) {
+                reached[d][neighborID] = generation;
+                score[d][neighborID] = aggregateScore;
+                from[d][neighborID] = SearchLink{ currentID, line };
+                queue[d].push(neighborID, aggregateScore + (d == 0 ? potential(neighborID) : -potential(neighborID)));
+                improved = true;
+            }
+            else if (aggregateScore < score[d][neighborID]) {
+                score[d][neighborID] = aggregateScore;
+                from[d][neighborID] = SearchLink{ currentID, line };
+                queue[d].decreaseKey(neighborID, aggregateScore + (d == 0 ? potential(neighborID) : -potential(neighborID)));
+                improved = true;
+            }
+
+            // the searches meet once a node has labels from both directions
+            if (improved && reached[1 - d][neighborID] == generation) {
+                uint32_t arriving = d == 0 ? line : from[0][neighborID].line;
+                uint32_t leaving = d == 0 ? from[1][neighborID].line : line;
+                float total = score[0][neighborID] + score[1][neighborID] + joinPenalty(arriving, leaving);
+                if (total < best) {
+                    best = total;
+                    meet = neighborID;
+                }
+            }
+        }
+    }
+
+    if (meet == GRAPH_NO_NODE) return false; // no path found
+    return reconstruct(startID, meet, endID, destPath, destPathSize, numTransfers);
+}
+
+// walks the forward chain back from meet to start and the backward chain from meet to end, writing the path in order
+bool PathfindingContext::reconstruct(uint32_t start, uint32_t meet, uint32_t end, PathWrapper* destPath, int* destPathSize, int* numTransfers) {
+    int forwardEdges = 0;
+    for (uint32_t n = meet; n != start; n = from[0][n].node) {
+        forwardEdges++;
+    }
+    int backwardEdges = 0;
+    for (uint32_t n = meet; n != end; n = from[1][n].node) {
+        backwardEdges++;
+    }
+
+    int numEdges = forwardEdges + backwardEdges;
+    int pathSize = numEdges + 1;
+    if (numEdges == 0 || pathSize > VALID_NODES) {
+        // cosplaying as someone who cares about memory safety
+        #if PATHFINDER_ERRORS == true
+        std::cout << "ERR: encountered large path (" << pathSize << ") [" << nodes[start].id << " : " << nodes[end].id << " ]" << std::endl;
+        #endif
+        return false;
+    }
+
+    int i = forwardEdges - 1;
+    for (uint32_t n = meet; n != start; n = from[0][n].node) {
+        destPath[i--] = PathWrapper{ &nodes[from[0][n].node], pathGraph.lineOf(from[0][n].line) };
+    }
+    i = forwardEdges;
+    for (uint32_t n = meet; n != end; n = from[1][n].node) {
+        destPath[i++] = PathWrapper{ &nodes[n], pathGraph.lineOf(from[1][n].line) };
+    }
+    destPath[numEdges] = PathWrapper{ &nodes[end], destPath[numEdges - 1].line };
+    *destPathSize = pathSize;
+    *numTransfers = countTransfers(destPath, pathSize);
+
+    return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+#include "macros.h"
+#include "node.h"
+#include "pathgraph.h"
+
+// cost of travelling along an edge, given the line used to arrive at the edge's source node
+// (shared by every pathfinding engine so they all agree on the same cost model)
+inline float edgeCost(float weight, const Line* arrivingLine, const Line* line) {
+    return arrivingLine == line ? weight : weight + TRANSFER_PENALTY;
+}
+// same, with PathGraph line ids
+inline float edgeCost(float weight, uint32_t arrivingLine, uint32_t line) {
+    return arrivingLine == line ? weight : weight + TRANSFER_PENALTY;
+}
+
+// number of distinct line segments (including walking) along a path
+int countTransfers(const PathWrapper* path, int pathSize);
+
+// merges consecutive stops on the same line into legs, returns the number of legs written
+int compressPath(const PathWrapper* path, int pathSize, PathLeg* destLegs);
+
+// total cost of a path under the shared cost model, used to compare engines
+float pathCost(const PathWrapper* path, int pathSize);
+
+// builds the contraction hierarchy or landmark tables the first time their engine is used, other engines need nothing
+// safe to call from any thread, concurrent callers wait for the build
+void prepareEngine(int engine);
+
+// indexed binary min-heap of node ids keyed by score, supports decrease-key
+// positions are only meaningful for ids pushed since the last clear()
+class NodeHeap {
+public:
+    NodeHeap(size_t numNodes = 0);
+
+    inline bool empty() {
+        return size == 0;
+    }
+    inline void clear() {
+        size = 0;
+    }
+    inline unsigned int top() {
+        return heap[0];
+    }
+    inline float topKey() {
+        return keys[heap[0]];
+    }
+
+    void push(unsigned int id, float key);
+    void decreaseKey(unsigned int id, float key);
+    unsigned int pop();
+private:
+    std::vector<unsigned int> heap;
+    std::vector<unsigned int> pos;
+    std::vector<float> keys;
+    int size;
+
+    void siftUp(int i);
+    void siftDown(int i);
+};
+
+// node and line a search label was reached through (PathGraph ids)
+struct SearchLink {
+    uint32_t node;
+    uint32_t line;
+};
+
+// scratch space for pathfinding, one per thread, sized to the loaded network when constructed
+// searches run on the global PathGraph, all arrays are indexed by Node::numerID and are reset by bumping the generation counter instead of being cleared
+// [0] holds the forward search (from start), [1] the backward search (from end)
+class PathfindingContext {
+public:
+    PathfindingContext();
+
+    unsigned int expanded; // nodes expanded by the last query
+
+    // room for the longest possible path (shortest paths never revisit a node), for callers of the searches below
+    inline PathWrapper* pathBuffer() {
+        return stops.data();
+    }
+    inline PathLeg* legBuffer() {
+        return legs.data();
+    }
+
+    // A* from start to end using the shared cost model, never touches Node state
+    // on success writes the path to destPath and the number of distinct line segments to numTransfers
+    bool aStar(Node* start, Node* end, PathWrapper* destPath, int* destPathSize, int* numTransfers);
+
+    // A* with the larger of the straight line and landmark (ALT) estimates, same cost model and output as aStar
+    // landmark bounds are admissible but not consistent, so improved labels of expanded nodes are reopened
+    bool altAStar(Node* start, Node* end, PathWrapper* destPath, int* destPathSize, int* numTransfers);
+
+    // bidirectional A* with averaged potentials, same cost model and output as aStar
+    bool bidirectionalAStar(Node* start, Node* end, PathWrapper* destPath, int* destPathSize, int* numTransfers);
+private:
+    unsigned int generation;
+    std::vector<unsigned int> reached[2]; // == generation if the node has a score this query
+    std::vector<unsigned int> closed[2]; // == generation if the node has been expanded this query
+    std::vector<float> score[2];
+    std::vector<SearchLink> from[2]; // forward: previous node and line used to arrive, backward: next node and line used to leave
+    NodeHeap queue[2];
+    std::vector<PathWrapper> stops;
+    std::vector<PathLeg> legs;
+
+    void nextGeneration();
+    template<class Estimate>
+    bool bestFirst(Node* start, Node* end, PathWrapper* destPath, int* destPathSize, int* numTransfers, Estimate estimate, bool reopen);
+    bool reconstruct(uint32_t start, uint32_t meet, uint32_t end, PathWrapper* destPath, int* destPathSize, int* numTransfers);
+};
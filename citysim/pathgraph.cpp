@@ -0,0 +1,38 @@
+#include "pathgraph.h"
+
+extern Node* nodes;
+extern Line* lines;
+extern Line WALKING_LINE;
+extern int VALID_NODES;
+extern int VALID_LINES;
+
+PathGraph::PathGraph() {
+    walkLine = 0;
+}
+
+void PathGraph::build() {
+    walkLine = VALID_LINES;
+    first.assign(VALID_NODES + 1, 0);
+    edges.clear();
+    position.resize(VALID_NODES);
+    for (int i = 0; i < VALID_NODES; i++) {
+        Node& node = nodes[i];
+        first[i] = (uint32_t)edges.size();
+        position[i] = node.getPosition();
+        for (unsigned int j = 0; j < node.numNeighbors; j++) {
+            edges.push_back(GraphEdge{ node.neighbors[j].node->numerID, idOf(node.neighbors[j].line), node.weights[j] });
+        }
+    }
+    first[VALID_NODES] = (uint32_t)edges.size();
+    edges.shrink_to_fit();
+}
+
+Line* PathGraph::lineOf(uint32_t line) const {
+    if (line == GRAPH_NO_LINE) return nullptr;
+    return line == walkLine ? &WALKING_LINE : &lines[line];
+}
+
+uint32_t PathGraph::idOf(const Line* line) const {
+    if (line == nullptr) return GRAPH_NO_LINE;
+    return line == &WALKING_LINE ? walkLine : (uint32_t)(line - lines);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "macros.h"
+#include "geometry.h"
+#include "node.h"
+
+constexpr uint32_t GRAPH_NO_NODE = 0xFFFFFFFF;
+constexpr uint32_t GRAPH_NO_LINE = 0xFFFFFFFF; // arriving line of search start points, never equal to an edge's line
+
+// edge of the search graph, line indexes lines (or is walkLine for walking transfers)
+struct GraphEdge {
+    uint32_t node;
+    uint32_t line;
+    float weight;
+};
+
+// read-only compressed sparse row copy of the station graph, built once the network is loaded
+// every search engine runs on it instead of chasing Node pointers, nodes are Node::numerID and edges keep neighbor order
+class PathGraph {
+public:
+    PathGraph();
+
+    void build();
+
+    inline uint32_t numNodes() const {
+        return (uint32_t)position.size();
+    }
+    // edges of node are first[node] to first[node + 1]
+    inline uint32_t firstEdge(uint32_t node) const {
+        return first[node];
+    }
+    inline uint32_t lastEdge(uint32_t node) const {
+        return first[node + 1];
+    }
+    inline const GraphEdge& edge(uint32_t e) const {
+        return edges[e];
+    }
+    // straight line distance in cost units, the A* heuristic
+    inline float estimate(uint32_t from, uint32_t to) const {
+        return distance(position[from], position[to]) * DISTANCE_SCALE;
+    }
+
+    Line* lineOf(uint32_t line) const;
+    uint32_t idOf(const Line* line) const;
+private:
+    std::vector<uint32_t> first;
+    std::vector<GraphEdge> edges;
+    std::vector<Vec2> position;
+    uint32_t walkLine;
+};
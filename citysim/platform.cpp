@@ -0,0 +1,12 @@
+#include "platform.h"
+
+PlatformQueue* platforms; // indexed by (Line::firstStop + stopInd) * 2 + direction
+
+void allocatePlatforms(size_t numStops) {
+	delete[] platforms;
+	platforms = new PlatformQueue[numStops * 2];
+}
+
+PlatformQueue& platformQueue(Line* line, int stopInd, int direction) {
+	return platforms[(line->firstStop + stopInd) * 2 + direction];
+}
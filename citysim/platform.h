@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include "macros.h"
+#include "line.h"
+
+// citizen waiting for a train, and the index of the stop where it gets off
+struct PlatformRider {
+	unsigned int citizen;
+	unsigned int alightInd;
+};
+
+// riders waiting at one stop of a line for trains heading in one direction
+// only used by the simulation thread: citizens are pushed after each worker batch, trains pop during the train update
+class PlatformQueue {
+public:
+	inline void push(const PlatformRider& rider) {
+		riders.push_back(rider);
+	}
+
+	inline bool empty() {
+		return riders.empty();
+	}
+	inline size_t size() {
+		return riders.size();
+	}
+	inline PlatformRider pop() {
+		PlatformRider rider = riders.front();
+		riders.pop_front();
+		return rider;
+	}
+	template<class F>
+	void forEach(F fn) {
+		for (PlatformRider& rider : riders) {
+			fn(rider);
+		}
+	}
+	// drops every rider pred(rider) returns true for, keeping the others in order
+	template<class F>
+	void removeIf(F pred) {
+		riders.erase(std::remove_if(riders.begin(), riders.end(), pred), riders.end());
+	}
+private:
+	std::deque<PlatformRider> riders;
+};
+
+// two queues (one per direction) for every line stop, call once the network is loaded
+void allocatePlatforms(size_t numStops);
+
+// queue for riders boarding line at path[stopInd] towards PLATFORM_FORWARD (increasing indices) or PLATFORM_BACKWARD
+PlatformQueue& platformQueue(Line* line, int stopInd, int direction);
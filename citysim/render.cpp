@@ -0,0 +1,432 @@
+#include <SFML/Graphics.hpp>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "macros.h"
+#include "line.h"
+#include "node.h"
+#include "patharena.h"
+#include "routetable.h"
+#include "train.h"
+#include "snapshot.h"
+#include "render.h"
+
+typedef sf::Vector2f Vector2f;
+
+// state owned by the simulation core (sim.cpp, node.cpp)
+// anything changing while the simulation runs is read from the latest snapshot, lines and node positions are fixed after init
+extern bool toggleSpawn;
+extern bool simPause;
+extern long unsigned int renderTick;
+extern int NODE_GRID_ROW_SIZE;
+extern int NODE_GRID_COL_SIZE;
+extern std::vector<std::vector<std::vector<Node*>>> nodeGrid;
+extern int VALID_LINES;
+extern int VALID_NODES;
+extern int VALID_TRAINS;
+extern Line* lines;
+extern Node* nodes;
+extern Train* trains;
+extern std::mutex customCitizenSpawnMutex;
+extern std::atomic<bool> customSpawnCitizens;
+extern std::atomic<bool> shouldExit;
+extern std::condition_variable doPathfinding;
+extern std::condition_variable doCustomCitizenSpawn;
+extern std::condition_variable doSimulation;
+extern std::atomic<bool> debugReportRequested;
+extern SnapshotBuffer snapshots;
+extern Node* nearestNode;
+extern Line WALKING_LINE;
+extern PathArena paths;
+extern RouteTable routes;
+extern std::atomic<int> pathfindingEngine;
+extern const char* PATHFINDING_ENGINE_NAMES[NUM_PATHFINDING_ENGINES];
+
+static inline sf::Vector2f toVector(const Vec2& v) {
+	return sf::Vector2f(v.x, v.y);
+}
+
+static inline sf::Color toColor(const LineColor& c) {
+	return sf::Color(c.r, c.g, c.b, c.a);
+}
+
+// unit circle outline starting at the top, same winding as sf::CircleShape
+static std::vector<sf::Vector2f> circlePoints(int numPoints) {
+	std::vector<sf::Vector2f> points(numPoints);
+	for (int i = 0; i < numPoints; i++) {
+		float angle = i * 2 * 3.141592654f / numPoints - 3.141592654f / 2;
+		points[i] = sf::Vector2f(std::cos(angle), std::sin(angle));
+	}
+	return points;
+}
+
+void renderingThread() {
+	// window 
+	sf::ContextSettings settings;
+	settings.antialiasingLevel = ANTIALIAS_LEVEL;
+	sf::RenderWindow window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "CitySim", sf::Style::Titlebar | sf::Style::Close, settings);
+	window.setFramerateLimit(TARGET_FPS);
+	window.requestFocus();
+
+	// white background
+	sf::RectangleShape bg(Vector2f(WINDOW_WIDTH * ZOOM_MIN * 2, WINDOW_HEIGHT * ZOOM_MIN * 2));
+	bg.setPosition(WINDOW_WIDTH * -ZOOM_MIN, WINDOW_HEIGHT * -ZOOM_MIN);
+	bg.setFillColor(BACKGROUND_COLOR);
+
+	// info text (top left)
+	sf::Text text;
+	sf::Font font;
+	font.loadFromFile("Arial.ttf");
+	text.setFont(font);
+	text.setCharacterSize(TEXT_FONT_SIZE);
+	text.setFillColor(sf::Color::Black);
+
+	// draw handlers and utilities
+	sf::Clock clock;
+	sf::View view(Vector2f(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2), Vector2f(WINDOW_WIDTH, WINDOW_HEIGHT));
+	sf::View textView(view);
+	Vector2f panOffset(0, 0);
+	Vector2f panVelocity(0, 0);
+	float simZoom = 1.0f;
+	bool drawNodes = true;
+	bool drawLines = true;
+	bool drawTrains = true;
+
+	// nodes take the color of the last line serving them, trains the color of their line
+	std::vector<sf::Color> nodeColors(VALID_NODES, sf::Color::Black);
+	std::vector<sf::Color> trainColors(VALID_TRAINS, sf::Color::Black);
+	for (int i = 0; i < VALID_LINES; i++) {
+		for (int j = 0; j < lines[i].size; j++) {
+			nodeColors[lines[i].path[j] - nodes] = toColor(lines[i].color);
+		}
+	}
+	for (int i = 0; i < VALID_TRAINS; i++) {
+		trainColors[i] = toColor(trains[i].line->color);
+	}
+	sf::Color unlistedColor; // selection of the placeholder node
+
+	// generate vertex buffer for line (path) shapes
+	// copy line data to 1 dimensional vertex vector
+	std::vector<sf::Vertex> lineVertices;
+	lineVertices.reserve(VALID_NODES);
+	for (int i = 0; i < VALID_LINES; i++) {
+		for (int j = 0; j < lines[i].size; j++) {
+			sf::Vector2f position = toVector(lines[i].path[j]->getPosition());
+			sf::Color color = nodeColors[lines[i].path[j] - nodes];
+
+			if (j != 0) lineVertices.push_back(sf::Vertex(position, color));
+			lineVertices.push_back(sf::Vertex(position, color));
+		}
+		if (!lineVertices.empty()) lineVertices.pop_back();
+	}
+
+	// copy vector data to buffer and clear leftovers
+	sf::VertexBuffer linesVertexBuffer(sf::Lines, sf::VertexBuffer::Usage::Static);
+	linesVertexBuffer.create(lineVertices.size());
+	linesVertexBuffer.update(lineVertices.data());
+	lineVertices.clear();
+	lineVertices.shrink_to_fit();
+
+	// initialize vertex array for nodes, trains
+	// not sure if I should be using a VertexBuffer for these
+	sf::VertexArray nodeVertices(sf::Triangles);
+	sf::VertexArray trainVertices(sf::Triangles);
+	nodeVertices.resize(VALID_NODES * NODE_N_POINTS * 3);
+	trainVertices.resize(VALID_TRAINS * TRAIN_N_POINTS * 3);
+
+	// used to properly render node/train sizes
+	float TRAIN_CAPACITY_FLOAT = float(TRAIN_CAPACITY);
+	float NODE_CAPACITY_FLOAT = float(NODE_CAPACITY);
+	std::vector<sf::Vector2f> trainPoints = circlePoints(TRAIN_N_POINTS);
+	std::vector<sf::Vector2f> nodePoints = circlePoints(NODE_N_POINTS);
+
+	// handlers to draw custom user paths
+	Node* userStartNode = nullptr;
+	Node* userEndNode = nullptr;
+	char userNodesSelected = 0;
+	PathHandle userPath = NULL_PATH; // held until the selection is cleared
+	sf::VertexBuffer userPathVertexBuffer(sf::LinesStrip, sf::VertexBuffer::Usage::Static);
+	sf::Color firstColor;
+	sf::Color secondColor;
+
+	// default render text
+	Node NEARBY_NODE = Node();
+	strcpy(NEARBY_NODE.id, "No nearby station");
+	auto nodeColor = [&](Node* node) -> sf::Color& {
+		return node >= nodes && node < nodes + VALID_NODES ? nodeColors[node - nodes] : unlistedColor;
+	};
+
+	while (window.isOpen() && !shouldExit) {
+		renderTick++;
+
+		// fps limiter
+		sf::Time frameStart = clock.getElapsedTime();
+
+		// latest published tick, never waits for the simulation
+		const SimSnapshot& snapshot = snapshots.acquire();
+
+		// get nearest node (uses node grid)
+		float minDist = FLT_MAX;
+		nearestNode = &NEARBY_NODE;
+		// calculate relative mouse position (in terms of window units, scaled to zoom + pan)
+		Vector2f relMousePos = Vector2f(sf::Mouse::getPosition(window)) + view.getCenter() - Vector2f(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2);
+		relMousePos = view.getCenter() + (relMousePos - view.getCenter()) * simZoom;
+		int mx = std::max(std::min((int) relMousePos.x / NODE_GRID_ROW_SIZE, NODE_GRID_ROWS - 1), 0);
+		int my = std::max(std::min((int) relMousePos.y / NODE_GRID_COL_SIZE, NODE_GRID_COLS - 1), 0);
+		int mouseXLower = mx > 0 ? mx - 1 : mx; int mouseXUpper = mx < NODE_GRID_ROWS - 1 ? mx + 1 : mx;
+		int mouseYLower = my > 0 ? my - 1 : my; int mouseYUpper = my < NODE_GRID_COLS - 1 ? my + 1 : my;
+		for (int i = mouseXLower; i <= mouseXUpper; i++) {
+			for (int j = mouseYLower; j <= mouseYUpper; j++) {
+				for (Node* node : nodeGrid[i][j]) {
+					float dist = node->dist(relMousePos.x, relMousePos.y);
+					if (dist < minDist) {
+						minDist = dist;
+						nearestNode = node;
+					}
+				}
+			}
+		}
+
+		// handle window events
+		sf::Event event;
+		while (window.pollEvent(event))
+		{
+			// close
+			if (event.type == sf::Event::Closed) {
+				simPause = false;
+				doSimulation.notify_all();
+				shouldExit = true;
+				window.close();
+			}
+			// zoom
+			else if (event.type == sf::Event::MouseWheelScrolled) {
+				float zoom = 1.0f + event.mouseWheelScroll.delta * ZOOM_AMT * -1;
+				simZoom *= zoom;
+				if (simZoom > ZOOM_MAX && simZoom < ZOOM_MIN) {
+					view.zoom(zoom);
+				}
+				else {
+					simZoom = std::max(ZOOM_MAX, std::min(simZoom, ZOOM_MIN));
+				}
+			}
+			// pan with mouse
+			else if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
+				panOffset = Vector2f(sf::Mouse::getPosition(window)) - view.getCenter();
+			}
+			else if (event.type == sf::Event::MouseMoved && sf::Mouse::isButtonPressed(sf::Mouse::Left)) {
+				view.setCenter(Vector2f(sf::Mouse::getPosition(window)) - panOffset);
+			}
+			// draw custom paths by right clicking to select nearest node
+			else if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Right) {
+				std::vector<sf::Vertex> userPathVertices;
+				switch (userNodesSelected) {
+				case 0:
+					userStartNode = nearestNode;
+					if (nodeColor(userStartNode) != sf::Color::Cyan) {
+						firstColor = nodeColor(userStartNode);
+					}
+					nodeColor(userStartNode) = sf::Color::Cyan;
+					#if USER_INFO_MODE == true
+					std::cout << "INFO: User selected start " << userStartNode->id << std::endl;
+					#endif
+					userNodesSelected++;
+					break;
+				case 1:
+					userEndNode = nearestNode;
+					userPath = userStartNode != userEndNode ? userStartNode->findPath(userEndNode) : NULL_PATH;
+					if (userPath != NULL_PATH) {
+						const PathLeg* legs = paths.legs(userPath);
+						int numLegs = paths.size(userPath);
+						if (nodeColor(userEndNode) != sf::Color::Cyan) {
+							secondColor = nodeColor(userEndNode);
+						}
+						nodeColor(userEndNode) = sf::Color::Cyan;
+						#if USER_INFO_MODE == true
+						std::cout << "INFO: User selected end " << userEndNode->id << std::endl << "Path: ";
+						for (int i = 0; i < numLegs; i++) {
+							std::cout << legs[i].board->id << "," << legs[i].line->id << "->";
+						}
+						std::cout << userEndNode->id << ",fin" << std::endl;
+						#endif
+						// draw every stop passed along each leg
+						for (int i = 0; i < numLegs; i++) {
+							const PathLeg& leg = legs[i];
+							if (leg.line == &WALKING_LINE) {
+								userPathVertices.push_back(sf::Vertex(toVector(leg.board->getPosition()), toColor(leg.line->color)));
+								continue;
+							}
+							int step = leg.direction() == PLATFORM_FORWARD ? 1 : -1;
+							for (int j = (int)leg.boardInd; j != (int)leg.alightInd; j += step) {
+								userPathVertices.push_back(sf::Vertex(toVector(leg.line->path[j]->getPosition()), toColor(leg.line->color)));
+							}
+						}
+						userPathVertices.push_back(sf::Vertex(toVector(userEndNode->getPosition()), toColor(legs[numLegs - 1].line->color)));
+						userPathVertexBuffer.create(userPathVertices.size());
+						userPathVertexBuffer.update(userPathVertices.data());
+						userNodesSelected++;
+					}
+					#if USER_INFO_MODE == true
+					else {
+						std::cout << "INFO: FAILED to path to User selection " << userEndNode->id << std::endl;
+					}
+					#endif
+					break;
+				case 2:
+					#if USER_INFO_MODE == true
+					std::cout << "INFO: User cleared selection" << std::endl;
+					#endif
+					nodeColor(userStartNode) = firstColor;
+					nodeColor(userEndNode) = secondColor;
+					if (userPath != NULL_PATH) {
+						paths.release(userPath);
+						userPath = NULL_PATH;
+					}
+					userPathVertices.clear();
+					userPathVertexBuffer.update(userPathVertices.data());
+					userNodesSelected = 0;
+					break;
+				}
+			}
+			else if (event.type == sf::Event::KeyPressed) {
+				// press up arrow to pan up
+				if (event.key.code == sf::Keyboard::Up) {
+					panVelocity += Vector2f(0, -ARROW_PAN_AMT);
+				}
+				// press down arrow to pan down
+				if (event.key.code == sf::Keyboard::Down) {
+					panVelocity += Vector2f(0, ARROW_PAN_AMT);
+				}
+				// press left arrow to pan left
+				if (event.key.code == sf::Keyboard::Left) {
+					panVelocity += Vector2f(-ARROW_PAN_AMT, 0);
+				}
+				// press right arrow to pan right
+				if (event.key.code == sf::Keyboard::Right) {
+					panVelocity += Vector2f(ARROW_PAN_AMT, 0);
+				}
+				// press 1 to toggle nodes visibility
+				if (event.key.code == sf::Keyboard::Num1) {
+					drawNodes = !drawNodes;
+				}
+				// press 2 to toggle lines visibility
+				if (event.key.code == sf::Keyboard::Num2) {
+					drawLines = !drawLines;
+				}
+				// press 3 to toggle trains visibility
+				if (event.key.code == sf::Keyboard::Num3) {
+					drawTrains = !drawTrains;
+				}
+				// press p to toggle simulation pause
+				if (event.key.code == sf::Keyboard::P) {
+					simPause = !simPause;
+					doSimulation.notify_all();
+					doPathfinding.notify_all();
+				}
+				// press space to spawn CUSTOM_CITIZEN_SPAWN_AMT citizens at the nearest node
+				if (event.key.code == sf::Keyboard::Space) {
+					std::unique_lock<std::mutex> customCitizenSpawnLock(customCitizenSpawnMutex);
+					customSpawnCitizens = true;
+					doPathfinding.notify_one();
+					doCustomCitizenSpawn.wait(customCitizenSpawnLock, [] {return !customSpawnCitizens;  });
+				}
+				// press semicolon to print useful information for debugging/performance analysis
+				if (event.key.code == sf::Keyboard::Semicolon) {
+					debugReportRequested = true;
+					doSimulation.notify_all();
+				}
+				// press e to cycle the pathfinding engine used on route table/cache misses
+				if (event.key.code == sf::Keyboard::E) {
+					int engine = (pathfindingEngine.load(std::memory_order_relaxed) + 1) % NUM_PATHFINDING_ENGINES;
+					pathfindingEngine.store(engine, std::memory_order_relaxed);
+					#if USER_INFO_MODE == true
+					std::cout << "INFO: Pathfinding engine " << PATHFINDING_ENGINE_NAMES[engine];
+					if (routes.loaded()) std::cout << " (unused, the route table answers every query)";
+					std::cout << std::endl;
+					#endif
+				}
+				// press backspace to toggle "passive" citizen spawning
+				if (event.key.code == sf::Keyboard::Backspace) {
+					toggleSpawn = !toggleSpawn;
+				}
+			}
+		}
+
+		// apply arrow key pan
+		panVelocity *= PAN_DECAY;
+		panVelocity.x = std::max(std::min(panVelocity.x, MAX_PAN_VELOCITY), -MAX_PAN_VELOCITY);
+		panVelocity.y = std::max(std::min(panVelocity.y, MAX_PAN_VELOCITY), -MAX_PAN_VELOCITY);
+		view.move(panVelocity);
+
+		window.clear();
+		window.setView(view);
+		window.draw(bg);
+
+		// refresh text every TEXT_REFRESH_RATE frames
+		if (renderTick % TEXT_REFRESH_RATE == 0) {
+			size_t c = snapshot.activeCitizens;
+			std::string speedString;
+			if (!simPause) {
+				speedString = std::to_string(snapshot.simSpeed) + " ticks/sec\n" + std::to_string(snapshot.touchedCitizens) + " citizens touched/tick\n"
+					+ std::to_string(int(snapshot.workerIdle * 100)) + "% worker idle\n";
+			}
+			else {
+				speedString = "Simulation paused (tick " + std::to_string(snapshot.tick) + ")\n";
+			}
+			unsigned int nearestLoad = nearestNode >= nodes && nearestNode < nodes + VALID_NODES ? snapshot.nodeLoads[nearestNode - nodes] : 0;
+			text.setString(std::to_string(c) + " active citizens\n" + speedString + nearestNode->id + " [" + std::to_string(nearestLoad) + "]");
+		}
+
+		if (drawTrains) {
+			for (int i = 0; i < VALID_TRAINS; i++) {
+				float newRadius = TRAIN_MIN_SIZE + snapshot.trainLoads[i] / TRAIN_CAPACITY_FLOAT * (TRAIN_SIZE_DIFF);
+				sf::Vector2f trainPosition = toVector(snapshot.trainPositions[i]);
+				sf::Color trainColor = trainColors[i];
+				for (int j = 0; j < TRAIN_N_POINTS; j++) {
+					int idx = i * TRAIN_N_POINTS * 3 + j * 3;
+					trainVertices[idx] = sf::Vertex(trainPosition + trainPoints[j] * newRadius, trainColor);
+					trainVertices[idx+1] = sf::Vertex(trainPosition, trainColor);
+					trainVertices[idx+2] = sf::Vertex(trainPosition + trainPoints[(j + 1) % TRAIN_N_POINTS] * newRadius, trainColor);
+				}
+			}
+
+			window.draw(trainVertices);
+		}
+
+		if (drawNodes) {
+			for (int i = 0; i < VALID_NODES; i++) {
+				float newRadius = NODE_MIN_SIZE + std::min(NODE_CAPACITY, snapshot.nodeLoads[i]) / NODE_CAPACITY_FLOAT * (NODE_SIZE_DIFF);
+				sf::Vector2f nodePosition = toVector(nodes[i].getPosition());
+				sf::Color color = nodeColors[i];
+				for (int j = 0; j < NODE_N_POINTS; j++) {
+					int idx = i * NODE_N_POINTS * 3 + j * 3;
+					nodeVertices[idx] = sf::Vertex(nodePosition + nodePoints[j] * newRadius, color);
+					nodeVertices[idx+1] = sf::Vertex(nodePosition, color);
+					nodeVertices[idx+2] = sf::Vertex(nodePosition + nodePoints[(j + 1) % NODE_N_POINTS] * newRadius, color);
+				}
+			}
+
+			window.draw(nodeVertices);
+		}
+
+		if (drawLines) {
+			if (userNodesSelected == 2) {
+				window.draw(userPathVertexBuffer);
+			}
+			else {
+				window.draw(linesVertexBuffer);
+			}
+		}
+
+		window.setView(textView);
+		window.draw(text);
+
+		window.display();
+	}
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// SFML window, runs on its own thread and reads the snapshots published by the simulation thread (besides user input)
+// the only part of the program that depends on SFML, headless builds (BENCHMARK_MODE or RENDER_MODE false) leave render.cpp out
+void renderingThread();
@@ -0,0 +1,179 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include "routetable.h"
+#include "pathfinder.h"
+#include "util.h"
+
+extern Node* nodes;
+extern Line* lines;
+extern Line WALKING_LINE;
+extern int VALID_NODES;
+extern int VALID_LINES;
+
+// compresses a stop-by-stop path into on-disk legs
+static void compressPath(PathWrapper* path, int pathSize, std::vector<RouteLeg>& dest) {
+    std::vector<PathLeg> legs(pathSize);
+    int numLegs = compressPath(path, pathSize, legs.data());
+    for (int i = 0; i < numLegs; i++) {
+        RouteLeg leg = RouteLeg();
+        leg.board = legs[i].board->numerID;
+        leg.alight = legs[i].alight->numerID;
+        leg.line = legs[i].line == &WALKING_LINE ? ROUTE_WALK_LINE : (uint16_t)(legs[i].line - lines);
+        leg.boardInd = (uint16_t)legs[i].boardInd;
+        leg.alightInd = (uint16_t)legs[i].alightInd;
+        dest.push_back(leg);
+    }
+}
+
+RouteTable::RouteTable() {
+    header = nullptr;
+    offsets = nullptr;
+    legs = nullptr;
+}
+
+bool RouteTable::fits() {
+    if (VALID_NODES > ROUTE_TABLE_MAX_NODES || VALID_NODES > 0x10000 || VALID_LINES >= ROUTE_WALK_LINE) return false;
+    for (int i = 0; i < VALID_LINES; i++) {
+        if (lines[i].size > 0x10000) return false;
+    }
+    return true;
+}
+
+uint64_t RouteTable::networkChecksum() {
+    uint64_t hash = util::hashBytes(&ROUTE_TABLE_VERSION, sizeof(ROUTE_TABLE_VERSION));
+    util::hashFile(LINES_CSV_FILE, &hash);
+    util::hashFile(STATIONS_CSV_FILE, &hash);
+
+    const float costModel[] = { TRANSFER_PENALTY, DISTANCE_SCALE, TRANSFER_MAX_DIST, TRANSFER_PENALTY_MULTIPLIER, PATH_MAX_LEGS };
+    hash = util::hashBytes(costModel, sizeof(costModel), hash);
+
+    // generated edges also depend on position normalization, so hash the graph itself
+    for (int i = 0; i < VALID_NODES; i++) {
+        Node& node = nodes[i];
+        for (unsigned int j = 0; j < node.numNeighbors; j++) {
+            Line* line = node.neighbors[j].line;
+            uint32_t edge[3] = { node.neighbors[j].node->numerID, line == &WALKING_LINE ? ROUTE_WALK_LINE : (uint32_t)(line - lines), 0 };
+            std::memcpy(&edge[2], &node.weights[j], sizeof(float));
+            hash = util::hashBytes(edge, sizeof(edge), hash);
+        }
+    }
+    return hash;
+}
+
+bool RouteTable::setData(const char* data, size_t size, uint64_t checksum) {
+    const RouteTableHeader* h = (const RouteTableHeader*)data;
+    if (size < sizeof(RouteTableHeader) || h->magic != ROUTE_TABLE_MAGIC || h->version != ROUTE_TABLE_VERSION) return false;
+    if (h->checksum != checksum || h->numNodes != (uint32_t)VALID_NODES) return false;
+
+    size_t numPairs = (size_t)h->numNodes * h->numNodes;
+    size_t expectedSize = sizeof(RouteTableHeader) + (numPairs + 1) * sizeof(uint32_t) + (size_t)h->numLegs * sizeof(RouteLeg);
+    if (size != expectedSize) return false;
+
+    header = h;
+    offsets = (const uint32_t*)(data + sizeof(RouteTableHeader));
+    legs = (const RouteLeg*)(offsets + numPairs + 1);
+    return true;
+}
+
+bool RouteTable::load(const char* path, uint64_t checksum) {
+    header = nullptr;
+    if (!file.open(path)) return false;
+    if (!setData(file.data(), file.size(), checksum)) {
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+bool RouteTable::build(const char* path, uint64_t checksum) {
+    header = nullptr;
+    file.close();
+
+    // solve each start node's row independently, rows are split between threads
+    int numNodes = VALID_NODES;
+    std::vector<std::vector<RouteLeg>> rowLegs(numNodes);
+    std::vector<std::vector<uint32_t>> rowCounts(numNodes, std::vector<uint32_t>(numNodes, 0));
+    unsigned int numThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < numThreads; t++) {
+        workers.emplace_back([t, numThreads, numNodes, &rowLegs, &rowCounts] {
+            PathfindingContext* context = new PathfindingContext();
+            PathWrapper* path = context->pathBuffer();
+            int pathSize;
+            int numTransfers;
+            for (int s = t; s < numNodes; s += numThreads) {
+                for (int e = 0; e < numNodes; e++) {
+                    if (s == e || !context->aStar(&nodes[s], &nodes[e], path, &pathSize, &numTransfers)) continue;
+                    size_t before = rowLegs[s].size();
+                    compressPath(path, pathSize, rowLegs[s]);
+                    // routes longer than citizens can follow are stored as not found, like in Node::computePath
+                    if (rowLegs[s].size() - before > PATH_MAX_LEGS) {
+                        rowLegs[s].resize(before);
+                        continue;
+                    }
+                    rowCounts[s][e] = (uint32_t)(rowLegs[s].size() - before);
+                }
+            }
+            delete context;
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    // flatten rows into the on-disk layout
+    size_t numPairs = (size_t)numNodes * numNodes;
+    size_t totalLegs = 0;
+    for (auto& row : rowLegs) totalLegs += row.size();
+
+    RouteTableHeader h = RouteTableHeader();
+    h.magic = ROUTE_TABLE_MAGIC;
+    h.version = ROUTE_TABLE_VERSION;
+    h.checksum = checksum;
+    h.numNodes = numNodes;
+    h.numLegs = (uint32_t)totalLegs;
+
+    buffer.resize(sizeof(RouteTableHeader) + (numPairs + 1) * sizeof(uint32_t) + totalLegs * sizeof(RouteLeg));
+    std::memcpy(buffer.data(), &h, sizeof(h));
+    uint32_t* offs = (uint32_t*)(buffer.data() + sizeof(RouteTableHeader));
+    RouteLeg* out = (RouteLeg*)(offs + numPairs + 1);
+    uint32_t offset = 0;
+    for (int s = 0; s < numNodes; s++) {
+        std::copy(rowLegs[s].begin(), rowLegs[s].end(), out + offset);
+        for (int e = 0; e < numNodes; e++) {
+            offs[s * numNodes + e] = offset;
+            offset += rowCounts[s][e];
+        }
+    }
+    offs[numPairs] = offset;
+
+    std::ofstream outFile(path, std::ios::binary | std::ios::trunc);
+    if (outFile.is_open() && outFile.write(buffer.data(), buffer.size())) {
+        outFile.close();
+        if (load(path, checksum)) {
+            buffer.clear();
+            buffer.shrink_to_fit();
+            return true;
+        }
+    }
+
+    std::cerr << "Could not write " << path << ", keeping route table in memory" << std::endl;
+    return setData(buffer.data(), buffer.size(), checksum);
+}
+
+bool RouteTable::get(Node* start, Node* end, PathLeg* destLegs, int* numLegs) {
+    size_t pair = (size_t)start->numerID * header->numNodes + end->numerID;
+    uint32_t first = offsets[pair];
+    uint32_t last = offsets[pair + 1];
+    if (first == last) return false;
+
+    for (uint32_t i = first; i < last; i++) {
+        const RouteLeg& leg = legs[i];
+        Line* line = leg.line == ROUTE_WALK_LINE ? &WALKING_LINE : &lines[leg.line];
+        destLegs[i - first] = PathLeg{ &nodes[leg.board], &nodes[leg.alight], line, leg.boardInd, leg.alightInd };
+    }
+    *numLegs = (int)(last - first);
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "node.h"
+#include "mappedfile.h"
+
+constexpr uint32_t ROUTE_TABLE_MAGIC = 0x54525343; // "CSRT"
+constexpr uint32_t ROUTE_TABLE_VERSION = 2;
+constexpr uint16_t ROUTE_WALK_LINE = 0xFFFF;
+
+// one leg of a precomputed route
+// either ride lines[line] from path[boardInd] to path[alightInd], or walk from board to alight
+struct RouteLeg {
+    uint16_t board;
+    uint16_t alight;
+    uint16_t line;
+    uint16_t boardInd;
+    uint16_t alightInd;
+};
+
+// on-disk layout: header, numNodes * numNodes + 1 leg offsets (indexed by start * numNodes + end), legs
+struct RouteTableHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t checksum;
+    uint32_t numNodes;
+    uint32_t numLegs;
+};
+
+// all-pairs route table, solved once with the regular A* cost model and memory-mapped from disk
+// only used for networks of up to ROUTE_TABLE_MAX_NODES stations whose node, line and stop indices fit the 16 bit legs
+class RouteTable {
+public:
+    RouteTable();
+
+    // whether the loaded network is small enough for a route table
+    static bool fits();
+
+    // hash of the network files, cost model and generated graph, used to reject stale tables
+    static uint64_t networkChecksum();
+
+    // maps a table from disk, returns false if it is missing or was built for a different network
+    bool load(const char* path, uint64_t checksum);
+    // solves every OD pair, writes the table to path and loads it
+    bool build(const char* path, uint64_t checksum);
+
+    // copies the stored legs, returns false if there is no route
+    bool get(Node* start, Node* end, PathLeg* destLegs, int* numLegs);
+
+    inline bool loaded() {
+        return header != nullptr;
+    }
+    inline uint32_t numLegs() {
+        return loaded() ? header->numLegs : 0;
+    }
+private:
+    MappedFile file;
+    std::vector<char> buffer; // only used if the table could not be written to disk
+    const RouteTableHeader* header;
+    const uint32_t* offsets;
+    const RouteLeg* legs;
+
+    bool setData(const char* data, size_t size, uint64_t checksum);
+};
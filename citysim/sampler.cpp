@@ -0,0 +1,73 @@
+#include <atomic>
+#include <vector>
+#include "sampler.h"
+
+RidershipSampler::RidershipSampler() {
+	nodes = nullptr;
+	numNodes = 0;
+	prob = nullptr;
+	alias = nullptr;
+}
+
+RidershipSampler::~RidershipSampler() {
+	delete[] prob;
+	delete[] alias;
+}
+
+void RidershipSampler::build(Node* stations, int numStations) {
+	nodes = stations;
+	numNodes = numStations;
+	delete[] prob;
+	delete[] alias;
+	prob = new float[numNodes];
+	alias = new uint32_t[numNodes];
+
+	double total = 0;
+	for (int i = 0; i < numNodes; i++) {
+		total += nodes[i].ridership;
+	}
+
+	// scale weights so the average column holds exactly 1, then pair every short column with a tall one
+	std::vector<double> scaled(numNodes);
+	std::vector<int> small, large;
+	for (int i = 0; i < numNodes; i++) {
+		scaled[i] = total > 0 ? nodes[i].ridership * numNodes / total : 1.0;
+		alias[i] = (uint32_t)i;
+		(scaled[i] < 1.0 ? small : large).push_back(i);
+	}
+	while (!small.empty() && !large.empty()) {
+		int s = small.back(); small.pop_back();
+		int l = large.back();
+		prob[s] = (float)scaled[s];
+		alias[s] = (uint32_t)l;
+		scaled[l] -= 1.0 - scaled[s];
+		if (scaled[l] < 1.0) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+	// whatever is left is 1 up to rounding error
+	for (int i : small) prob[i] = 1.0f;
+	for (int i : large) prob[i] = 1.0f;
+}
+
+std::mt19937& threadRng() {
+	#if DETERMINISTIC_MODE == true
+	static unsigned int base = (unsigned int)DETERMINISTIC_SEED;
+	#else
+	static unsigned int base = std::random_device()();
+	#endif
+	static std::atomic<unsigned int> streams(0);
+	thread_local std::seed_seq seed{ base, streams++ };
+	thread_local std::mt19937 rng(seed);
+	return rng;
+}
+
+uint64_t spawnSeed() {
+	#if DETERMINISTIC_MODE == true
+	return DETERMINISTIC_SEED;
+	#else
+	static uint64_t seed = (uint64_t(std::random_device()()) << 32) | std::random_device()();
+	return seed;
+	#endif
+}
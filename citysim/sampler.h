@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include "macros.h"
+#include "node.h"
+
+// counter-based random stream: the nth number of stream s only depends on (seed, s, n), not on which thread asks for it
+// usable wherever the standard library expects a uniform random bit generator
+class CounterRng {
+public:
+	typedef uint32_t result_type;
+
+	CounterRng(uint64_t seed, uint64_t stream) {
+		key = mix(seed ^ mix(stream + 0x9E3779B97F4A7C15ull));
+		counter = 0;
+	}
+
+	static constexpr result_type min() {
+		return 0;
+	}
+	static constexpr result_type max() {
+		return 0xFFFFFFFF;
+	}
+	inline result_type operator()() {
+		return (result_type)(mix(key + ++counter * 0x9E3779B97F4A7C15ull) >> 32);
+	}
+private:
+	uint64_t key;
+	uint64_t counter;
+
+	// splitmix64 finalizer
+	static inline uint64_t mix(uint64_t z) {
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+};
+
+// origin and destination of a citizen that is about to be spawned
+struct Trip {
+	Node* start;
+	Node* end;
+};
+
+// Walker/Vose alias table over station ridership, each sample costs two random numbers and one table lookup
+// read-only after build(), so any number of threads can sample from it with their own random streams
+class RidershipSampler {
+public:
+	RidershipSampler();
+	~RidershipSampler();
+
+	void build(Node* stations, int numStations);
+
+	// draws a station with probability proportional to its ridership
+	template<class Rng>
+	inline Node* sample(Rng& rng) {
+		unsigned int i = (unsigned int)((uint64_t(rng()) * numNodes) >> 32);
+		float coin = (rng() >> 8) * (1.0f / (1 << 24));
+		return &nodes[coin < prob[i] ? i : alias[i]];
+	}
+
+	// fills dest with count trips between two different stations
+	template<class Rng>
+	void sampleTrips(Trip* dest, int count, Rng& rng) {
+		for (int i = 0; i < count; i++) {
+			Node* start = sample(rng);
+			Node* end;
+			do {
+				end = sample(rng);
+			} while (end == start);
+			dest[i] = Trip{ start, end };
+		}
+	}
+private:
+	Node* nodes;
+	int numNodes;
+	float* prob; // chance of keeping column i rather than taking its alias
+	uint32_t* alias;
+};
+
+// random stream owned by the calling thread, seeded separately for every thread
+// in DETERMINISTIC_MODE the seeds only depend on DETERMINISTIC_SEED and the order threads first ask for their stream
+std::mt19937& threadRng();
+
+// seed for the spawner's counter-based streams (fixed in DETERMINISTIC_MODE)
+uint64_t spawnSeed();
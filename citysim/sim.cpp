@@ -1,30 +1,42 @@
-#include <SFML/Graphics.hpp>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <time.h>
 #include <condition_variable>
 #include <stack>
 #include <set>
 #include <future>
 #include <random>
+#include <map>
+#include <cstring>
 
 #include "macros.h"
 #include "line.h"
 #include "node.h"
+#include "patharena.h"
 #include "pathcache.h"
+#include "pathfinder.h"
+#include "pathgraph.h"
+#include "routetable.h"
+#include "contraction.h"
 #include "train.h"
 #include "citizen.h"
+#include "executor.h"
+#include "sampler.h"
+#include "spawner.h"
+#include "snapshot.h"
+#include "network.h"
 #include "util.h"
+#include "render.h"
 
 // weighted-random node selection
 unsigned int totalRidership;
-std::random_device rd;
-std::mt19937 gen(rd());
-std::uniform_int_distribution<int> dis;
+RidershipSampler ridershipSampler;
 
 // simulation controls
 bool toggleSpawn;
@@ -37,9 +49,25 @@ unsigned int handledCitizens;
 std::vector<int> activeCitizensStat;
 std::vector<double> clockStat;
 std::vector<int> simSpeedStat;
-extern int pathRequests;
-extern int pathCacheHits;
-extern int pathFails;
+std::vector<int> touchedCitizensStat; // citizens woken per tick, averaged over STAT_RATE ticks
+unsigned long touchedCitizens;
+std::vector<float> workerIdleStat; // share of worker time spent waiting at the tick barrier, averaged over STAT_RATE ticks
+std::vector<float> workerImbalanceStat; // slowest / average worker busy time, averaged over STAT_RATE ticks
+std::vector<unsigned int> citizenOutcomes; // ticks until each due citizen wakes again (or CITIZEN_OUTCOME_DESPAWNED), applied in due order after the batch
+std::vector<NodeArrivals> citizenArrivals; // station arrivals collected by each worker, counted on the nodes after the batch
+std::vector<unsigned int> citizenDespawns; // compacted out of the live index after the batch
+#if DETERMINISTIC_MODE == true
+uint64_t stateHash; // chained over every tick, see hashState()
+#endif
+unsigned long despawnedCitizens;
+extern PathArena paths;
+extern PathCache cache;
+extern std::atomic<int> pathRequests;
+extern std::atomic<int> pathSharedHits;
+extern std::atomic<int> pathTableHits;
+extern std::atomic<int> pathFails;
+extern std::atomic<unsigned long> pathSearches;
+extern std::atomic<unsigned long> pathNodesExpanded;
 
 // node grid
 int NODE_GRID_ROW_SIZE;
@@ -50,65 +78,196 @@ std::vector<std::vector<std::vector<Node*>>> nodeGrid;
 int VALID_LINES;
 int VALID_NODES;
 int VALID_TRAINS;
-Line lines[MAX_LINES];
-Node nodes[MAX_NODES];
-Train trains[MAX_TRAINS];
+Line* lines; // sized and filled by network::allocate (see network.h)
+Node* nodes;
+Train* trains;
 CitizenVector citizens(CITIIZEN_VEC_RESERVE, MAX_CITIZENS);
 
 // multithreading managers
-std::mutex trainsMutex; // locks trains array for drawing/simulating
 std::mutex pathsMutex; // pause helper
 std::mutex customCitizenSpawnMutex; // pause helper
-extern std::mutex blockStack; // see citizen.cpp
 std::atomic<bool> customSpawnCitizens(false); // pause helper
-std::atomic<bool> justDidPathfinding(false); // pause helper
 std::atomic<bool> shouldExit(false); // global thread control
-std::condition_variable doPathfinding; // pauses pathfinding thread
+std::condition_variable doPathfinding; // wakes pathfinding thread for custom citizen spawning
 std::condition_variable doCustomCitizenSpawn; // pings pathfinding thread for custom citizen spawning
 std::condition_variable doSimulation; // pauses simulation thread
+std::atomic<bool> debugReportRequested(false); // report is printed by the simulation thread between ticks
+
+// state published for the renderer at the end of every tick
+SnapshotBuffer snapshots;
 
 // misc
 Node* nearestNode;
 Line WALKING_LINE;
+extern RouteTable routes;
+extern PathGraph pathGraph;
+extern ContractionHierarchy hierarchy;
+extern std::atomic<int> pathfindingEngine;
+const char* PATHFINDING_ENGINE_NAMES[NUM_PATHFINDING_ENGINES] = { "A*", "Bidirectional A*", "Contraction hierarchy", "A* (ALT landmarks)" };
 
 // spawns spawnAmount citizens at random nodes (selection weighted by ridership)
 static void generateRandomCitizens(int spawnAmount) {
 	if (spawnAmount <= 0) return;
 
 	int spawnedCount = 0;
+	Trip trips[CITIZEN_SPAWN_BATCH];
 
 	while (spawnedCount < spawnAmount && !simPause) {
-		int startRidership = dis(gen);
-		int endRidership;
-		int startNode, startRidershipCount;
-		int endNode, endRidershipCount;
-		int i;
-		do {
-			i = 0;
-			startNode = 0; startRidershipCount = 0;
-			endNode = 0; endRidershipCount = 0;
-			endRidership = dis(gen);
-			while (startRidershipCount < startRidership || endRidershipCount < endRidership) {
-				if (startRidershipCount < startRidership) {
-					startRidershipCount += nodes[i].ridership;
-					startNode = i;
-				}
-				if (endRidershipCount < endRidership) {
-					endRidershipCount += nodes[i].ridership;
-					endNode = i;
-				}
-				i++;
+		int batch = std::min(spawnAmount - spawnedCount, CITIZEN_SPAWN_BATCH);
+		ridershipSampler.sampleTrips(trips, batch, threadRng());
+		for (int i = 0; i < batch && !simPause; i++) {
+			if (citizens.add(trips[i].start, trips[i].end)) {
+				handledCitizens++;
+				spawnedCount++;
 			}
-		} while (endNode == startNode);
+		}
+	}
+}
 
-		if (citizens.add(&nodes[startNode], &nodes[endNode])) {
-			handledCitizens++;
-			spawnedCount++;
+#if CITIZEN_VERIFY_MODE == true
+std::atomic<unsigned long>* citizenUpdateTicks = new std::atomic<unsigned long>[MAX_CITIZENS](); // last tick each citizen was updated on
+std::atomic<unsigned long> doubleUpdates;
+unsigned long verifyChecks;
+unsigned long verifiedCitizens;
+unsigned long verifyErrors;
+
+// every live citizen has to be waiting in exactly one place: the timer wheel, a platform queue or a train
+// station and train capacities have to match the citizens in them
+// anything found there that isn't live must have just been spawned (it joins the live index on the next compaction)
+static void verifyCitizens() {
+	std::vector<unsigned char> seen(citizens.max(), 0);
+	std::vector<unsigned char> isLive(citizens.max(), 0);
+	unsigned long errors = 0;
+	auto found = [&](unsigned int id, bool ok) {
+		if (id >= seen.size() || !ok) {
+			errors++;
+			return;
+		}
+		seen[id]++;
+	};
+
+	citizenWheel.forEach([&](unsigned int id) {
+		char status = citizens[id].status;
+		found(id, status == STATUS_SPAWNED || status == STATUS_WALK || status == STATUS_TRANSFER || status == STATUS_ALIGHTED);
+	});
+	for (int l = 0; l < VALID_LINES; l++) {
+		for (int s = 0; s < lines[l].size; s++) {
+			for (int d = 0; d < 2; d++) {
+				platformQueue(&lines[l], s, d).forEach([&](PlatformRider& rider) {
+					found(rider.citizen, citizens[rider.citizen].status == STATUS_AT_STOP);
+				});
+			}
 		}
 	}
+	for (int t = 0; t < VALID_TRAINS; t++) {
+		for (std::vector<unsigned int>& riders : trains[t].riders) {
+			for (unsigned int id : riders) {
+				found(id, citizens[id].status == STATUS_IN_TRANSIT);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < citizens.liveSize(); i++) {
+		unsigned int id = citizens.liveId(i);
+		isLive[id] = 1;
+		if (seen[id] != 1 || citizens[id].status == STATUS_DESPAWNED) errors++;
+	}
+	for (size_t id = 0; id < seen.size(); id++) {
+		if (!isLive[id] && seen[id] > 0 && (seen[id] > 1 || citizens[(unsigned int)id].status != STATUS_SPAWNED)) errors++;
+	}
+
+	if (errors > 0) {
+		std::cout << "ERR: " << errors << " citizens lost or tracked twice at tick " << simTick << std::endl;
+	}
+
+	// stations count citizens walking through them or waiting on a platform, trains count their riders
+	std::vector<unsigned int> waiting(VALID_NODES, 0);
+	for (size_t i = 0; i < citizens.liveSize(); i++) {
+		Citizen c = citizens[citizens.liveId(i)];
+		if (c.status == STATUS_TRANSFER || c.status == STATUS_AT_STOP) waiting[c.currentLeg().board->numerID]++;
+	}
+	unsigned long capacityErrors = 0;
+	for (int n = 0; n < VALID_NODES; n++) {
+		if (nodes[n].capacity != waiting[n]) capacityErrors++;
+	}
+	for (int t = 0; t < VALID_TRAINS; t++) {
+		size_t riders = 0;
+		for (std::vector<unsigned int>& r : trains[t].riders) riders += r.size();
+		if (trains[t].capacity != riders) capacityErrors++;
+	}
+	if (capacityErrors > 0) {
+		std::cout << "ERR: " << capacityErrors << " stations/trains with wrong capacity at tick " << simTick << std::endl;
+	}
+	errors += capacityErrors;
+	verifyChecks++;
+	verifiedCitizens += citizens.liveSize();
+	verifyErrors += errors;
+}
+#endif
+
+#if DETERMINISTIC_MODE == true
+// folds every live citizen's state and every train's position into hash, in live index order
+static uint64_t hashState(uint64_t hash) {
+	for (size_t i = 0; i < citizens.liveSize(); i++) {
+		unsigned int id = citizens.liveId(i);
+		Citizen c = citizens[id];
+		hash = util::hashBytes(&id, sizeof(id), hash);
+		hash = util::hashBytes(&c.status, sizeof(c.status), hash);
+		hash = util::hashBytes(&c.index, sizeof(c.index), hash);
+	}
+	for (int t = 0; t < VALID_TRAINS; t++) {
+		Train& train = trains[t];
+		hash = util::hashBytes(&train.status, sizeof(train.status), hash);
+		hash = util::hashBytes(&train.index, sizeof(train.index), hash);
+		hash = util::hashBytes(&train.timer, sizeof(train.timer), hash);
+		hash = util::hashBytes(&train.capacity, sizeof(train.capacity), hash);
+	}
+	return hash;
+}
+#endif
+
+// despawns citizens who have waited for or ridden a train longer than CITIZEN_DESPAWN_THRESH ticks
+// nothing wakes them otherwise (e.g. on a line without trains in their direction), so they would hold their slot forever
+// runs on the simulation thread between ticks, where platform queues and trains can be edited directly
+static void cullCitizens() {
+	auto timedOut = [](unsigned int id) {
+		if (citizens.waited(id, simTick) <= CITIZEN_DESPAWN_THRESH) return false;
+		#if CITIZEN_SPAWN_ERRORS == true
+		std::cout << "ERR: despawned TIMEOUT citizen @" << int(citizens[id].index) << ": " << citizens[id].currentPathStr() << std::endl;
+		#endif
+		citizenDespawns.push_back(id);
+		return true;
+	};
+
+	for (int l = 0; l < VALID_LINES; l++) {
+		for (int s = 0; s < lines[l].size; s++) {
+			for (int d = 0; d < 2; d++) {
+				platformQueue(&lines[l], s, d).removeIf([&](const PlatformRider& rider) {
+					if (!timedOut(rider.citizen)) return false;
+					lines[l].path[s]->capacity--;
+					return true;
+				});
+			}
+		}
+	}
+	for (int t = 0; t < VALID_TRAINS; t++) {
+		Train& train = trains[t];
+		for (std::vector<unsigned int>& stopRiders : train.riders) {
+			size_t kept = stopRiders.size();
+			stopRiders.erase(std::remove_if(stopRiders.begin(), stopRiders.end(), timedOut), stopRiders.end());
+			train.capacity -= (unsigned int)(kept - stopRiders.size());
+		}
+	}
+
+	for (unsigned int id : citizenDespawns) {
+		citizens.despawn(id);
+	}
+	despawnedCitizens += citizenDespawns.size();
+	citizens.compact(citizenDespawns);
 }
 
 // prints a bunch of stuff to the console on ; press
+// runs on the simulation thread between ticks, the citizen census is too large to copy into every snapshot
 static void debugReport() {
 	std::cout << "Report at tick " << simTick << ":" << std::endl;
 
@@ -116,17 +275,19 @@ static void debugReport() {
 	std::map<std::string, unsigned int> stuckMap;
 	std::map<std::string, int> statusMap{ {"DSPN", 0}, {"SPWN", 0}, {"MOVE", 0}, {"TSFR", 0}, {"STOP", 0}, {"WALK", 0}, {"STUCK", 0} };
 	double citizenAgeTotal = 0;
-	for (int i = 0; i < citizens.size(); i++) {
-		Citizen& c = citizens[i];
-		if (c.status != STATUS_DESPAWNED && c.timer > CITIZEN_DESPAWN_WARN && c.status != STATUS_WALK) {
+	size_t agedCitizens = 0;
+	for (size_t i = 0; i < citizens.liveSize(); i++) {
+		Citizen c = citizens[citizens.liveId(i)];
+		if (citizens.waited(citizens.liveId(i), simTick) > CITIZEN_DESPAWN_WARN) {
 			stuckMap[c.currentPathStr()]++;
 			statusMap["STUCK"]++;
 		}
-		citizenAgeTotal += citizens[i].timer;
+		// spawnTick is only set on the first update
+		if (c.status != STATUS_SPAWNED) {
+			citizenAgeTotal += simTick - c.spawnTick;
+			agedCitizens++;
+		}
 		switch (c.status) {
-			case STATUS_DESPAWNED:
-				statusMap["DSPN"]++;
-				break;
 			case STATUS_SPAWNED:
 				statusMap["SPWN"]++;
 				break;
@@ -145,6 +306,8 @@ static void debugReport() {
 		}
 	}
 
+	statusMap["DSPN"] = int(citizens.size() - citizens.liveSize());
+
 	bool actuallyStuck = false;
 	for (auto const& x : stuckMap) {
 		if (x.second > CITIZEN_STUCK_THRESH) {
@@ -176,7 +339,7 @@ static void debugReport() {
 		std::cout << "%\t" << std::flush;
 	}
 	std::cout << std::endl;
-	std::cout << "Average citizen age: " << citizenAgeTotal / citizens.size() << std::endl;
+	std::cout << "Average citizen age: " << (agedCitizens > 0 ? citizenAgeTotal / agedCitizens : 0) << " ticks" << std::endl;
 
 	// display problematic nodes
 	bool foundLargeNode = false;
@@ -190,150 +353,215 @@ static void debugReport() {
 	if (foundLargeNode) std::cout << std::endl;
 
 	// display node pathfinding diagnostics
-	std::cout << "Patch cache hit rate: " << pathCacheHits << " hits=" << std::flush;
-	std::printf("%.2f", (float)(pathCacheHits) / pathRequests * 100);
+	std::cout << "Path cache reverse hit rate: " << cache.hits() << " hits=" << std::flush;
+	std::printf("%.2f", (float)(cache.hits()) / pathRequests * 100);
+	std::cout << "% (" << cache.misses() << " misses, " << cache.evictions() << " evictions)" << std::flush;
+	std::cout << ", shared path hit rate: " << pathSharedHits << " hits=" << std::flush;
+	std::printf("%.2f", (float)(pathSharedHits) / pathRequests * 100);
+	std::cout << "%, route table hit rate: " << pathTableHits << " hits=" << std::flush;
+	std::printf("%.2f", (float)(pathTableHits) / pathRequests * 100);
 	std::cout << "%, fail rate: " << pathFails << " fails=" << std::flush;
 	std::printf("%.2f", (float)(pathFails) / pathRequests * 100);
 	std::cout << "% for " << pathRequests << " requests" << std::endl << std::flush;
+	std::cout << PATHFINDING_ENGINE_NAMES[pathfindingEngine.load(std::memory_order_relaxed)] << " expanded " << (pathSearches > 0 ? (double)pathNodesExpanded / pathSearches : 0) << " nodes/search over " << pathSearches << " searches" << std::endl;
 	pathRequests = 0;
-	pathCacheHits = 0;
+	pathSearches = 0;
+	pathNodesExpanded = 0;
+	cache.resetStats();
+	pathSharedHits = 0;
+	pathTableHits = 0;
 	pathFails = 0;
 
 	// display memory information (citizen vector)
-	std::cout << "Citizen vector size=" << citizens.size() << " active=" << citizens.activeSize() << " inactive=" << citizens.size() - citizens.activeSize() << " cap=" << citizens.capacity() << " max=" << citizens.max() << std::endl;
+	std::cout << "Citizen vector size=" << citizens.size() << " active=" << citizens.activeSize() << " inactive=" << citizens.size() - citizens.activeSize() << " live=" << citizens.liveSize() << " cap=" << citizens.capacity() << " max=" << citizens.max() << " (" << CitizenVector::citizenBytes() << "B/citizen)" << std::endl;
+	std::cout << "Shared paths live=" << paths.live() << " (" << paths.bytes() / 1024 << "KB)" << std::endl;
+
+	// display tick executor balance
+	if (!workerIdleStat.empty()) {
+		std::cout << "Citizen workers idle=" << workerIdleStat.back() * 100 << "% imbalance=" << workerImbalanceStat.back() << "x" << std::endl;
+	}
 
 	std::cout << std::endl;
 }
 
-// utility class to manage threads used for updating citizens every simulation tick
-class CitizenThreadPool {
-public:
-	// creates a thread pool with numThreads worker threads
-	CitizenThreadPool(size_t numThreads) {
-		stop = false;
-		for (size_t i = 0; i < numThreads; ++i) {
-			workers.emplace_back([this] { workerThread(); });
-		}
+#if PATHFINDING_BENCHMARK_MODE == true
+// times raw searches (bypassing the path cache and route table) and regular findPath calls between random station pairs
+static void pathfindingBenchmark() {
+	std::mt19937 benchGen(0);
+	std::uniform_int_distribution<int> nodeDis(0, VALID_NODES - 1);
+	std::vector<std::pair<Node*, Node*>> pairs;
+	pairs.reserve(PATHFINDING_BENCHMARK_AMT);
+	while (pairs.size() < PATHFINDING_BENCHMARK_AMT) {
+		int a = nodeDis(benchGen);
+		int b = nodeDis(benchGen);
+		if (a != b) pairs.push_back({ &nodes[a], &nodes[b] });
 	}
 
-	// kills all worker threads
-	~CitizenThreadPool() {
-		{
-			std::unique_lock<std::mutex> threadPoolQueueLock(threadPoolQueueMutex);
-			stop = true;
-		}
-		citizenThreadCV.notify_all();
-		for (std::thread& worker : workers) {
-			worker.join();
+	std::vector<PathWrapper> path(VALID_NODES);
+	int pathSize;
+	int numTransfers;
+	PathfindingContext* context = new PathfindingContext();
+
+	int found;
+	unsigned long expanded;
+	double start, elapsed;
+	for (int engine = 0; engine < NUM_PATHFINDING_ENGINES; engine++) {
+		prepareEngine(engine);
+		found = 0;
+		expanded = 0;
+		start = double(clock());
+		for (auto& p : pairs) {
+			if (engine == PATHFINDING_ENGINE_CH) {
+				found += hierarchy.query(p.first, p.second, path.data(), &pathSize, &numTransfers);
+				expanded += hierarchy.expanded();
+			}
+			else {
+				if (engine == PATHFINDING_ENGINE_ASTAR) found += context->aStar(p.first, p.second, path.data(), &pathSize, &numTransfers);
+				else if (engine == PATHFINDING_ENGINE_ALT) found += context->altAStar(p.first, p.second, path.data(), &pathSize, &numTransfers);
+				else found += context->bidirectionalAStar(p.first, p.second, path.data(), &pathSize, &numTransfers);
+				expanded += context->expanded;
+			}
 		}
+		elapsed = (double(clock()) - start) / CLOCKS_PER_SEC;
+		std::cout << PATHFINDING_ENGINE_NAMES[engine] << " (uncached): " << PATHFINDING_BENCHMARK_AMT / elapsed << " paths/sec, " << (double)expanded / PATHFINDING_BENCHMARK_AMT << " nodes expanded/query, " << expanded / elapsed << " nodes expanded/sec, " << found << "/" << PATHFINDING_BENCHMARK_AMT << " found" << std::endl;
 	}
 
-	// gives a worker a new task (function f)
-	template<class F>
-	void enqueue(F&& f) {
-		{
-			std::unique_lock<std::mutex> threadPoolQueueLock(threadPoolQueueMutex);
-			tasks.emplace(std::forward<F>(f));
+	found = 0;
+	start = double(clock());
+	for (auto& p : pairs) {
+		PathHandle h = p.first->findPath(p.second);
+		if (h != NULL_PATH) {
+			found++;
+			paths.release(h);
 		}
-		citizenThreadCV.notify_one();
 	}
+	elapsed = (double(clock()) - start) / CLOCKS_PER_SEC;
+	std::cout << "findPath: " << PATHFINDING_BENCHMARK_AMT / elapsed << " paths/sec, " << found << "/" << PATHFINDING_BENCHMARK_AMT << " found" << std::endl;
 
-	// waits until a worker has finished its tasks
-	void waitForCompletion() {
-		std::unique_lock<std::mutex> threadPoolQueueLock(threadPoolQueueMutex);
-		citizenThreadDoneCV.wait(threadPoolQueueLock, [this] { return tasks.empty() && activeThreads == 0; });
-	}
-private:
-	std::vector<std::thread> workers;
-	std::queue<std::function<void()>> tasks;
-	std::mutex threadPoolQueueMutex;
-	std::condition_variable citizenThreadCV; // start task
-	std::condition_variable citizenThreadDoneCV; // complete task
-	std::atomic<bool> stop; // used to kill all threads on thread pool close
-	std::atomic<int> activeThreads{ 0 };
-
-	// worker executes functions in the function queue
-	void workerThread() {
-		while (!shouldExit) {
-			std::function<void()> task;
-			{
-				std::unique_lock<std::mutex> threadPoolQueueLock(threadPoolQueueMutex);
-				citizenThreadCV.wait(threadPoolQueueLock, [this] { return stop || !tasks.empty(); });
-				if (stop && tasks.empty()) {
-					return;
-				}
-				task = std::move(tasks.front());
-				tasks.pop();
-			}
-			activeThreads++;
-			task();
-			activeThreads--;
-			if (tasks.empty() && activeThreads == 0) {
-				citizenThreadDoneCV.notify_one();
-			}
+	delete context;
+}
+#endif
+
+#if CH_VALIDATION_MODE == true
+// compares path costs found by A* and the contraction hierarchy between random station pairs
+static void contractionValidation() {
+	std::mt19937 benchGen(0);
+	std::uniform_int_distribution<int> nodeDis(0, VALID_NODES - 1);
+	PathfindingContext* context = new PathfindingContext();
+	std::vector<PathWrapper> aStarPath(VALID_NODES);
+	std::vector<PathWrapper> chPath(VALID_NODES);
+	int aStarSize, chSize;
+	int numTransfers;
+
+	int equal = 0, chCheaper = 0, chWorse = 0, onlyAStar = 0, onlyCH = 0;
+	double aStarTime = 0, chTime = 0;
+	float maxDiff = 0;
+	prepareEngine(PATHFINDING_ENGINE_CH);
+	for (int i = 0; i < CH_VALIDATION_AMT; i++) {
+		Node* a = &nodes[nodeDis(benchGen)];
+		Node* b = &nodes[nodeDis(benchGen)];
+		if (a == b) continue;
+
+		double start = double(clock());
+		bool aStarFound = context->aStar(a, b, aStarPath.data(), &aStarSize, &numTransfers);
+		aStarTime += double(clock()) - start;
+		start = double(clock());
+		bool chFound = hierarchy.query(a, b, chPath.data(), &chSize, &numTransfers);
+		chTime += double(clock()) - start;
+
+		if (aStarFound != chFound) {
+			aStarFound ? onlyAStar++ : onlyCH++;
+			continue;
+		}
+		if (!aStarFound) continue;
+		float aStarCost = pathCost(aStarPath.data(), aStarSize);
+		float diff = pathCost(chPath.data(), chSize) - aStarCost;
+		// A* labels nodes rather than (node, line) states, so it can miss cheaper paths that the CH finds
+		if (std::abs(diff) <= aStarCost * 1e-5f) equal++;
+		else if (diff < 0) chCheaper++;
+		else {
+			chWorse++;
+			maxDiff = std::max(maxDiff, diff);
+			#if PATHFINDER_ERRORS == true
+			std::cout << "ERR: CH path more expensive than A* (+" << diff << ") [" << a->id << " : " << b->id << " ]" << std::endl;
+			#endif
 		}
 	}
-};
+	std::cout << "CH validation over " << CH_VALIDATION_AMT << " pairs: " << equal << " equal, " << chCheaper << " cheaper with CH, " << chWorse << " more expensive with CH (max +" << maxDiff << ")" << std::endl;
+	std::cout << "Found only by A*: " << onlyAStar << ", found only by CH: " << onlyCH << std::endl;
+	std::cout << "A*: " << CH_VALIDATION_AMT / (aStarTime / CLOCKS_PER_SEC) << " paths/sec, CH: " << CH_VALIDATION_AMT / (chTime / CLOCKS_PER_SEC) << " paths/sec" << std::endl;
 
-// initializes simulation variables
-int init() {
+	delete context;
+}
+#endif
+
+// parses the CSV files and generates the node grid, neighbors, line distances and trains (compiled into NETWORK_FILE afterwards)
+static int buildNetwork() {
+	// rows are parsed first, network storage is allocated once every size is known
+	struct ParsedLine {
+		std::string id;
+		LineColor color;
+		std::vector<int> path;
+	};
+	std::vector<ParsedLine> parsedLines;
+	std::vector<Node> parsedNodes;
 	// utility arrays for node position normalization
-	float* nodesX = new float[MAX_NODES];
-	float* nodesY = new float[MAX_NODES];
+	std::vector<float> nodesX;
+	std::vector<float> nodesY;
 
 	// read files
-	int row = 0;
 	std::string fileLine;
 
 	// parse [id, color, {path}] to generate lines
-	std::ifstream linesCSV("lines_stations.csv");
+	std::ifstream linesCSV(LINES_CSV_FILE);
 	if (!linesCSV.is_open()) {
-		std::cerr << "Error opening lines_stations.csv" << std::endl;
+		std::cerr << "Error opening " LINES_CSV_FILE << std::endl;
 		return ERROR_OPENING_FILE;
 	}
 
-	std::cout << "Reading lines_stations.csv" << std::endl;
+	std::cout << "Reading " LINES_CSV_FILE << std::endl;
 
 	while (std::getline(linesCSV, fileLine)) {
 		std::stringstream lineStream(fileLine);
 		std::string cell;
-		Line& line = lines[row];
+		parsedLines.push_back(ParsedLine());
+		ParsedLine& line = parsedLines.back();
 
 		int col = 0;
 		while (std::getline(lineStream, cell, ',')) {
 			if (col == 0) {
 				// line id (name) (e.g. 6, A_L, F)
-				std::strcpy(line.id, cell.c_str());
+				line.id = cell.substr(0, LINE_ID_SIZE - 1);
 			} else if (col == 1) {
-				// color (type sf::Color)
+				// color (type LineColor)
 				util::colorConvert(&line.color, cell);
 			} else {
-				// add Node ref to path (before Node initialization)
-				line.path[col - 2] = &nodes[std::stoi(cell)];
+				// add node index to path (before Node initialization)
+				line.path.push_back(std::stoi(cell));
 			}
 			col++;
 		}
-		row++;
 	}
 
-	VALID_LINES = row;
-	std::cout << "Processed " << VALID_LINES << " lines" << std::endl;
+	std::cout << "Processed " << parsedLines.size() << " lines" << std::endl;
 
 	// parse [numerID, id, x, y, numLines, ridership] to generate nodes
-	std::ifstream stationsCSV("stations_data.csv");
+	std::ifstream stationsCSV(STATIONS_CSV_FILE);
 	if (!stationsCSV.is_open()) {
-		std::cerr << "Error opening stations_data.csv" << std::endl;
+		std::cerr << "Error opening " STATIONS_CSV_FILE << std::endl;
 		return ERROR_OPENING_FILE;
 	}
 
-	std::cout << "Reading stations_data.csv" << std::endl;
+	std::cout << "Reading " STATIONS_CSV_FILE << std::endl;
 
-	row = 0;
 	while (std::getline(stationsCSV, fileLine)) {
 		std::stringstream lineStream(fileLine);
 		std::string cell;
-		Node& node = nodes[row];
+		parsedNodes.push_back(Node());
+		Node& node = parsedNodes.back();
 		node.status = STATUS_SPAWNED;
+		nodesX.push_back(0);
+		nodesY.push_back(0);
 
 		int col = 0;
 		while (std::getline(lineStream, cell, ',')) {
@@ -342,16 +570,24 @@ int init() {
 				node.numerID = std::stoi(cell);
 				break;
 			case 1: // station id (name) (e.g. Astor Pl, 23rd St)
-				std::strcpy(node.id, cell.c_str());
+				std::strncpy(node.id, cell.c_str(), NODE_ID_SIZE - 1);
+				node.id[NODE_ID_SIZE - 1] = '\0';
 				break;
 			case 2: // x coordinate
-				nodesX[row] = (std::stof(cell));
+				nodesX.back() = (std::stof(cell));
 				break;
 			case 3: // y coordinate
-				nodesY[row] = (std::stof(cell));
+				nodesY.back() = (std::stof(cell));
 				break;
 			case 4: // number of lines associated with this node
-				node.numLines = std::count(cell.begin(), cell.end(), '-') + 1;
+				{
+					size_t numLines = std::count(cell.begin(), cell.end(), '-') + 1;
+					if (numLines > 0xFF) {
+						std::cerr << "Station " << node.id << " lists more than 255 lines" << std::endl;
+						return ERROR_NETWORK_TOO_LARGE;
+					}
+					node.numLines = (unsigned char)numLines;
+				}
 				break;
 			case 5: // ridership (daily, 2019)
 				node.ridership = std::stoi(cell);
@@ -362,15 +598,51 @@ int init() {
 			}
 			col++;
 		}
-		row++;
 	}
 
-	VALID_NODES = row;
-	std::cout << "Processed " << VALID_NODES << " nodes (stations)" << std::endl;
-	std::cout << "Total system ridership: " << totalRidership << std::endl;
+	int numNodes = (int)parsedNodes.size();
+	std::cout << "Processed " << numNodes << " nodes (stations)" << std::endl;
+
+	// lines refer to stations by their CSV id, which can be anything unique (numerID becomes the index in nodes)
+	std::map<int, int> stationIndex;
+	for (int i = 0; i < numNodes; i++) {
+		if (!stationIndex.insert({ (int)parsedNodes[i].numerID, i }).second) {
+			std::cerr << "Station id " << parsedNodes[i].numerID << " is used more than once in " STATIONS_CSV_FILE << std::endl;
+			return ERROR_INVALID_NETWORK;
+		}
+		parsedNodes[i].numerID = i;
+	}
+
+	// lines end at their first stop that is not a known node, count stops and trains to size the network
+	std::vector<int> lineSizes;
+	int numTrains = 0;
+	for (ParsedLine& line : parsedLines) {
+		int j = 0;
+		while (j < (int)line.path.size()) {
+			auto station = stationIndex.find(line.path[j]);
+			if (station == stationIndex.end()) break;
+			line.path[j] = station->second;
+			j++;
+		}
+		lineSizes.push_back(j);
+		for (int k = 0; k < j; k += DEFAULT_TRAIN_STOP_SPACING) {
+			numTrains += (k == 0 || k == j - 1) ? 1 : 2;
+		}
+	}
 
-	// update randint generator for citizen generation
-	dis.param(std::uniform_int_distribution<int>::param_type(0, totalRidership));
+	if (!network::fits(numNodes, lineSizes, numTrains)) return ERROR_NETWORK_TOO_LARGE;
+	network::allocate(numNodes, lineSizes, numTrains);
+	for (int i = 0; i < VALID_NODES; i++) {
+		nodes[i] = parsedNodes[i];
+	}
+	for (int i = 0; i < VALID_LINES; i++) {
+		Line& line = lines[i];
+		std::strcpy(line.id, parsedLines[i].id.c_str());
+		line.color = parsedLines[i].color;
+		for (int j = 0; j < line.size; j++) {
+			line.path[j] = &nodes[parsedLines[i].path[j]];
+		}
+	}
 
 	// normalize node position data to screen boundaries
 	float minNodeX = nodesX[0]; float maxNodeX = nodesX[0];
@@ -384,7 +656,7 @@ int init() {
 	float minMaxDiffX = maxNodeX - minNodeX;
 	float minMaxDiffY = maxNodeY - minNodeY;
 	for (int i = 0; i < VALID_NODES; i++) {
-		nodes[i].setPosition(Vector2f(
+		nodes[i].setPosition(Vec2(
 			WINDOW_X_OFFSET + WINDOW_SCALE * WINDOW_X_SCALE * WINDOW_WIDTH * (nodesX[i] - minNodeX) / minMaxDiffX,
 			WINDOW_Y_OFFSET + WINDOW_HEIGHT - WINDOW_SCALE * WINDOW_Y_SCALE * WINDOW_HEIGHT * (nodesY[i] - minNodeY) / minMaxDiffY
 		));
@@ -400,7 +672,7 @@ int init() {
 		for (int j = 0; j < NODE_GRID_COLS; j++) {
 			std::vector<Node*> cell;
 			for (int k = 0; k < VALID_NODES; k++) {
-				Vector2f p = nodes[k].getPosition();
+				const Vec2& p = nodes[k].getPosition();
 				if (p.x >= i * NODE_GRID_ROW_SIZE && p.x < (i + 1) * NODE_GRID_ROW_SIZE && p.y >= j * NODE_GRID_COL_SIZE && p.y < (j + 1) * NODE_GRID_COL_SIZE) {
 					cell.push_back(&nodes[k]);
 					nodes[k].setGridPos(i, j);
@@ -416,11 +688,17 @@ int init() {
 
 	std::cout << "Generated node grid" << std::endl;
 
-	// add node walking transfer neighbors (all nodes within TRANSFER_MAX_DIST units)
-	WALKING_LINE = Line();
-	WALKING_LINE.color = sf::Color::Black;
-	std::strcpy(WALKING_LINE.id, WALK_LINE_ID_STR);
+	// neighbors are collected per node (skipping duplicate edges) and packed into the network's edge arrays afterwards
+	std::vector<std::vector<std::pair<PathWrapper, float>>> adjacency(VALID_NODES);
+	auto addNeighbor = [&adjacency](Node* node, const PathWrapper& neighbor, float weight) {
+		std::vector<std::pair<PathWrapper, float>>& edges = adjacency[node - nodes];
+		for (const std::pair<PathWrapper, float>& edge : edges) {
+			if (edge.first.node == neighbor.node && edge.first.line == neighbor.line) return;
+		}
+		edges.push_back({ neighbor, weight });
+	};
 
+	// add node walking transfer neighbors (all nodes within TRANSFER_MAX_DIST units)
 	int transferNeighbors = 0;
 	for (int n = 0; n < VALID_NODES; n++) {
 		Node& node = nodes[n];
@@ -431,8 +709,8 @@ int init() {
 					float dist = node.dist(other);
 					if (dist < TRANSFER_MAX_DIST) {
 						dist *= DISTANCE_SCALE * TRANSFER_PENALTY_MULTIPLIER;
-						node.addNeighbor({ other, &WALKING_LINE }, dist);
-						other->addNeighbor({ &node, &WALKING_LINE }, dist);
+						addNeighbor(&node, { other, &WALKING_LINE }, dist);
+						addNeighbor(other, { &node, &WALKING_LINE }, dist);
 						transferNeighbors++;
 					}
 				}
@@ -444,413 +722,131 @@ int init() {
 
 	// various preprocessing steps, generate train objects
 	int lineNeighbors = 0;
+	int trainInd = 0;
 
 	for (int i = 0; i < VALID_LINES; i++) {
-		int j = 0;
 		Line& line = lines[i];
-
-		// add line neighbors (adjacent nodes along line)
-		// update node colors for each line
-		while (j < LINE_PATH_SIZE && line.path[j] != nullptr && line.path[j]->status == STATUS_SPAWNED) {
-			if (j > 0) {
-				float dist = line.path[j]->dist(line.path[j - 1]) * DISTANCE_SCALE;
-				line.dist[j - 1] = dist;
-				struct PathWrapper one = { line.path[j], &line };
-				struct PathWrapper two = { line.path[j - 1], &line };
-				line.path[j]->addNeighbor(two, dist);
-				line.path[j - 1]->addNeighbor(one, dist);
-				lineNeighbors++;
-			}
-			line.path[j]->setFillColor(line.color);
-			j++;
+		int j = line.size;
+
+		// add line neighbors (adjacent nodes along line), generate distances between nodes on each line
+		for (int k = 1; k < j; k++) {
+			float dist = line.path[k]->dist(line.path[k - 1]) * DISTANCE_SCALE;
+			line.dist[k - 1] = dist;
+			struct PathWrapper one = { line.path[k], &line };
+			struct PathWrapper two = { line.path[k - 1], &line };
+			addNeighbor(line.path[k], two, dist);
+			addNeighbor(line.path[k - 1], one, dist);
+			lineNeighbors++;
 		}
-
-		// generate distances between nodes on each line
-		line.dist[j - 1] = line.dist[j - 2];
-
-		// update line size (length)
-		line.size = j;
+		if (j > 1) line.dist[j - 1] = line.dist[j - 2];
 
 		// generate train objects
-		std::string idStr = line.id;
-		int spacing = idStr.find("A_") == std::string::npos ? DEFAULT_TRAIN_STOP_SPACING / 2 : DEFAULT_TRAIN_STOP_SPACING; // avoid excessive generation for the A train
 		for (int k = 0; k < j; k+= DEFAULT_TRAIN_STOP_SPACING) {
 			// generate 2 trains (one going backward, one forward) except if at first/last stop
 			int repeat = (k == 0 || k == j - 1) ? 1 : 2;
 			for (int l = 0; l < repeat; l++) {
-				Train& train = trains[VALID_TRAINS++];
+				Train& train = trains[trainInd++];
 				train.setPosition(line.path[k]->getPosition());
 				train.line = &line;
 				train.index = k;
 				train.status = STATUS_TRANSFER;
 				train.statusForward = (l == 1) ? STATUS_BACKWARD : (k == j - 1) ? STATUS_BACKWARD : STATUS_FORWARD;
-				train.setFillColor(line.color);
 			}
 		}
 	}
+	network::setNeighbors(adjacency);
+	network::finalize();
 	std::cout << "Generated " << VALID_TRAINS << " trains" << std::endl;
 	std::cout << "Generated " << lineNeighbors << " line neighbors" << std::endl;
 	std::cout << "Total neighbors: " << transferNeighbors + lineNeighbors << std::endl;
 
-	// enable continuous citizen spawning by default (necessary to generate initial citizen batch)
-	toggleSpawn = true;
-
-	// generate initial batch of citizens
-	generateRandomCitizens(CITIZEN_SPAWN_INIT);
-	std::cout << "Generated " << CITIZEN_SPAWN_INIT << " initial citizens" << std::endl;
-
-	delete[] nodesX;
-	delete[] nodesY;
+	// station order in the CSV file is arbitrary, renumber so that nearby stations are close in nodes[] and every per-node array
+	#if NODE_ORDER != NODE_ORDER_CSV
+	float span = network::meanEdgeSpan();
+	network::renumber(NODE_ORDER);
+	std::cout << "Renumbered nodes, mean edge span " << span << " -> " << network::meanEdgeSpan() << std::endl;
+	#endif
 
-	std::cout << "INIT DONE!" << std::endl << std::endl;
 	return AOK;
 }
 
-void renderingThread() {
-	// window 
-	sf::ContextSettings settings;
-	settings.antialiasingLevel = ANTIALIAS_LEVEL;
-	sf::RenderWindow window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "CitySim", sf::Style::Titlebar | sf::Style::Close, settings);
-	window.setFramerateLimit(TARGET_FPS);
-	window.requestFocus();
-
-	// white background
-	sf::RectangleShape bg(Vector2f(WINDOW_WIDTH * ZOOM_MIN * 2, WINDOW_HEIGHT * ZOOM_MIN * 2));
-	bg.setPosition(WINDOW_WIDTH * -ZOOM_MIN, WINDOW_HEIGHT * -ZOOM_MIN);
-	bg.setFillColor(BACKGROUND_COLOR);
-
-	// info text (top left)
-	sf::Text text;
-	sf::Font font;
-	font.loadFromFile("Arial.ttf");
-	text.setFont(font);
-	text.setCharacterSize(TEXT_FONT_SIZE);
-	text.setFillColor(sf::Color::Black);
-
-	// draw handlers and utilities
-	sf::Clock clock;
-	sf::View view(Vector2f(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2), Vector2f(WINDOW_WIDTH, WINDOW_HEIGHT));
-	sf::View textView(view);
-	Vector2f panOffset(0, 0);
-	Vector2f panVelocity(0, 0);
-	float simZoom = 1.0f;
-	bool drawNodes = true;
-	bool drawLines = true;
-	bool drawTrains = true;
-
-	// generate vertex buffer for line (path) shapes
-	// copy line data to 1 dimensional vertex vector
-	std::vector<sf::Vertex> lineVertices;
-	lineVertices.reserve(VALID_NODES);
-	for (int i = 0; i < VALID_LINES; i++) {
-		int j = 0;
-		while (lines[i].path[j] != nullptr && lines[i].path[j]->status == STATUS_SPAWNED) {
-			sf::Vector2f position = lines[i].path[j]->getPosition();
-			sf::Color color = lines[i].path[j]->getFillColor();
+// initializes simulation variables
+int init() {
+	WALKING_LINE = Line();
+	WALKING_LINE.color = { 0, 0, 0, 255 };
+	std::strcpy(WALKING_LINE.id, WALK_LINE_ID_STR);
 
-			if (j != 0) lineVertices.push_back(sf::Vertex(position, color));
-			lineVertices.push_back(sf::Vertex(position, color));
-			j++;
-		}
-		if (!lineVertices.empty()) lineVertices.pop_back();
+	// map the compiled network, or parse the CSV files again if they (or the layout constants) have changed since it was written
+	double networkStart = double(clock());
+	uint64_t networkSource = network::sourceChecksum();
+	#if NETWORK_COMPILE_MODE == false
+	if (network::load(NETWORK_FILE, networkSource)) {
+		std::cout << "Loaded compiled network: " << VALID_NODES << " nodes, " << VALID_LINES << " lines, " << VALID_TRAINS << " trains (" << (double(clock()) - networkStart) / CLOCKS_PER_SEC * 1000 << "ms)" << std::endl;
 	}
-
-	// copy vector data to buffer and clear leftovers
-	sf::VertexBuffer linesVertexBuffer(sf::Lines, sf::VertexBuffer::Usage::Static);
-	linesVertexBuffer.create(lineVertices.size());
-	linesVertexBuffer.update(lineVertices.data());
-	lineVertices.clear();
-	lineVertices.shrink_to_fit();
-
-	// initialize vertex array for nodes, trains
-	// not sure if I should be using a VertexBuffer for these
-	sf::VertexArray nodeVertices(sf::Triangles);
-	sf::VertexArray trainVertices(sf::Triangles);
-	nodeVertices.resize(VALID_NODES * NODE_N_POINTS * 3);
-	trainVertices.resize(VALID_TRAINS * TRAIN_N_POINTS * 3);
-
-	// used to properly render node/train sizes
-	float TRAIN_CAPACITY_FLOAT = float(TRAIN_CAPACITY);
-	float NODE_CAPACITY_FLOAT = float(NODE_CAPACITY);
-
-	// handlers to draw custom user paths
-	Node* userStartNode = nullptr;
-	Node* userEndNode = nullptr;
-	char userNodesSelected = 0;
-	PathWrapper userPath[CITIZEN_PATH_SIZE];
-	char userPathSize;
-	sf::VertexBuffer userPathVertexBuffer(sf::LinesStrip, sf::VertexBuffer::Usage::Static);
-	sf::Color firstColor;
-	sf::Color secondColor;
-
-	// prevent out of bounds access
-	simSpeedStat.push_back(0);
-	clockStat.push_back(1);
-	clockStat.push_back(2);
-
-	// default render text
-	Node NEARBY_NODE = Node();
-	strcpy(NEARBY_NODE.id, "No nearby station");
-
-	while (window.isOpen() && !shouldExit) {
-		renderTick++;
-
-		// fps limiter
-		sf::Time frameStart = clock.getElapsedTime();
-
-		// get nearest node (uses node grid)
-		float minDist = FLT_MAX;
-		nearestNode = &NEARBY_NODE;
-		// calculate relative mouse position (in terms of window units, scaled to zoom + pan)
-		Vector2f relMousePos = Vector2f(sf::Mouse::getPosition(window)) + view.getCenter() - Vector2f(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2);
-		relMousePos = view.getCenter() + (relMousePos - view.getCenter()) * simZoom;
-		int mx = std::max(std::min((int) relMousePos.x / NODE_GRID_ROW_SIZE, NODE_GRID_ROWS - 1), 0);
-		int my = std::max(std::min((int) relMousePos.y / NODE_GRID_COL_SIZE, NODE_GRID_COLS - 1), 0);
-		int mouseXLower = mx > 0 ? mx - 1 : mx; int mouseXUpper = mx < NODE_GRID_ROWS - 1 ? mx + 1 : mx;
-		int mouseYLower = my > 0 ? my - 1 : my; int mouseYUpper = my < NODE_GRID_COLS - 1 ? my + 1 : my;
-		for (int i = mouseXLower; i <= mouseXUpper; i++) {
-			for (int j = mouseYLower; j <= mouseYUpper; j++) {
-				for (Node* node : nodeGrid[i][j]) {
-					float dist = node->dist(relMousePos.x, relMousePos.y);
-					if (dist < minDist) {
-						minDist = dist;
-						nearestNode = node;
-					}
-				}
-			}
-		}
-
-		// handle window events
-		sf::Event event;
-		while (window.pollEvent(event))
-		{
-			// close
-			if (event.type == sf::Event::Closed) {
-				simPause = false;
-				doSimulation.notify_all();
-				shouldExit = true;
-				window.close();
-			}
-			// zoom
-			else if (event.type == sf::Event::MouseWheelScrolled) {
-				float zoom = 1.0f + event.mouseWheelScroll.delta * ZOOM_AMT * -1;
-				simZoom *= zoom;
-				if (simZoom > ZOOM_MAX && simZoom < ZOOM_MIN) {
-					view.zoom(zoom);
-				}
-				else {
-					simZoom = std::max(ZOOM_MAX, std::min(simZoom, ZOOM_MIN));
-				}
-			}
-			// pan with mouse
-			else if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
-				panOffset = Vector2f(sf::Mouse::getPosition(window)) - view.getCenter();
-			}
-			else if (event.type == sf::Event::MouseMoved && sf::Mouse::isButtonPressed(sf::Mouse::Left)) {
-				view.setCenter(Vector2f(sf::Mouse::getPosition(window)) - panOffset);
-			}
-			// draw custom paths by right clicking to select nearest node
-			else if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Right) {
-				std::vector<sf::Vertex> userPathVertices;
-				switch (userNodesSelected) {
-				case 0:
-					memset(userPath, 0, sizeof(PathWrapper) * CITIZEN_PATH_SIZE); // easier debugging
-					userStartNode = nearestNode;
-					if (userStartNode->getFillColor() != sf::Color::Cyan) {
-						firstColor = userStartNode->getFillColor();
-					}
-					userStartNode->setFillColor(sf::Color::Cyan);
-					#if USER_INFO_MODE == true
-					std::cout << "INFO: User selected start " << userStartNode->id << std::endl;
-					#endif
-					userNodesSelected++;
-					break;
-				case 1:
-					userEndNode = nearestNode;
-					if (userStartNode != userEndNode && userStartNode->findPath(userEndNode, userPath, &userPathSize)) {
-						if (userEndNode->getFillColor() != sf::Color::Cyan) {
-							secondColor = userEndNode->getFillColor();
-						}
-						userEndNode->setFillColor(sf::Color::Cyan);
-						#if USER_INFO_MODE == true
-						std::cout << "INFO: User selected end " << userEndNode->id << std::endl << "Path: ";
-						for (int i = 0; i < userPathSize; i++) {
-							PathWrapper& p = userPath[i];
-							if (p.line == nullptr || p.node == nullptr) {
-								userPathSize--; // this is super janky! oh well
-								continue;
-							}
-							std::cout << p.node->id << "," << p.line->id << "->";
-						}
-						std::cout << "fin" << std::endl;
-						#endif
-						for (char i = 0; i < userPathSize; i++) {
-							userPathVertices.push_back(sf::Vertex(userPath[i].node->getPosition(), userPath[i].line->color));
-						}
-						userPathVertexBuffer.create(userPathSize);
-						userPathVertexBuffer.update(userPathVertices.data());
-						userNodesSelected++;
-					}
-					#if USER_INFO_MODE == true
-					else {
-						std::cout << "INFO: FAILED to path to User selection " << userEndNode->id << std::endl;
-					}
-					#endif
-					break;
-				case 2:
-					#if USER_INFO_MODE == true
-					std::cout << "INFO: User cleared selection" << std::endl;
-					#endif
-					userStartNode->setFillColor(firstColor);
-					userEndNode->setFillColor(secondColor);
-					userPathSize = 0;
-					userPathVertices.clear();
-					userPathVertexBuffer.update(userPathVertices.data());
-					userNodesSelected = 0;
-					break;
-				}
-			}
-			else if (event.type == sf::Event::KeyPressed) {
-				// press up arrow to pan up
-				if (event.key.code == sf::Keyboard::Up) {
-					panVelocity += Vector2f(0, -ARROW_PAN_AMT);
-				}
-				// press down arrow to pan down
-				if (event.key.code == sf::Keyboard::Down) {
-					panVelocity += Vector2f(0, ARROW_PAN_AMT);
-				}
-				// press left arrow to pan left
-				if (event.key.code == sf::Keyboard::Left) {
-					panVelocity += Vector2f(-ARROW_PAN_AMT, 0);
-				}
-				// press right arrow to pan right
-				if (event.key.code == sf::Keyboard::Right) {
-					panVelocity += Vector2f(ARROW_PAN_AMT, 0);
-				}
-				// press 1 to toggle nodes visibility
-				if (event.key.code == sf::Keyboard::Num1) {
-					drawNodes = !drawNodes;
-				}
-				// press 2 to toggle lines visibility
-				if (event.key.code == sf::Keyboard::Num2) {
-					drawLines = !drawLines;
-				}
-				// press 3 to toggle trains visibility
-				if (event.key.code == sf::Keyboard::Num3) {
-					drawTrains = !drawTrains;
-				}
-				// press p to toggle simulation pause
-				if (event.key.code == sf::Keyboard::P) {
-					simPause = !simPause;
-					doSimulation.notify_all();
-					doPathfinding.notify_all();
-				}
-				// press space to spawn CUSTOM_CITIZEN_SPAWN_AMT citizens at the nearest node
-				if (event.key.code == sf::Keyboard::Space) {
-					std::unique_lock<std::mutex> customCitizenSpawnLock(customCitizenSpawnMutex);
-					customSpawnCitizens = true;
-					doPathfinding.notify_one();
-					doCustomCitizenSpawn.wait(customCitizenSpawnLock, [] {return !customSpawnCitizens;  });
-				}
-				// press semicolon to print useful information for debugging/performance analysis
-				if (event.key.code == sf::Keyboard::Semicolon) {
-					debugReport();
-				}
-				// press backspace to toggle "passive" citizen spawning
-				if (event.key.code == sf::Keyboard::Backspace) {
-					toggleSpawn = !toggleSpawn;
-				}
-			}
+	else
+	#endif
+	{
+		std::cout << "Compiled network missing, stale or damaged, building it from " LINES_CSV_FILE " and " STATIONS_CSV_FILE << std::endl;
+		int networkStatus = buildNetwork();
+		if (networkStatus != AOK) return networkStatus;
+		if (!network::compile(NETWORK_FILE, networkSource)) {
+			std::cerr << "Could not write " NETWORK_FILE << std::endl;
 		}
+		std::cout << "Built network (" << (double(clock()) - networkStart) / CLOCKS_PER_SEC * 1000 << "ms)" << std::endl;
+	}
+	std::cout << "Total system ridership: " << totalRidership << std::endl;
+	#if NETWORK_COMPILE_MODE == true
+	return AOK;
+	#endif
 
-		// apply arrow key pan
-		panVelocity *= PAN_DECAY;
-		panVelocity.x = std::max(std::min(panVelocity.x, MAX_PAN_VELOCITY), -MAX_PAN_VELOCITY);
-		panVelocity.y = std::max(std::min(panVelocity.y, MAX_PAN_VELOCITY), -MAX_PAN_VELOCITY);
-		view.move(panVelocity);
-
-		window.clear();
-		window.setView(view);
-		window.draw(bg);
-
-		// refresh text every TEXT_REFRESH_RATE frames
-		if (renderTick % TEXT_REFRESH_RATE == 0) {
-			size_t c = citizens.activeSize();
-			std::string speedString;
-			if (!simPause) {
-				int s = simSpeedStat[simSpeedStat.size() - 1];
-				speedString = std::to_string(s) + " ticks/sec\n";
-			}
-			else {
-				speedString = "Simulation paused (tick " + std::to_string(simTick) + ")\n";
-			}
-			text.setString(std::to_string(c) + " active citizens\n" + speedString + nearestNode->id + " [" + std::to_string(nearestNode->capacity) + "]");
-		}
+	// weighted station selection for citizen generation
+	ridershipSampler.build(nodes, VALID_NODES);
 
-		if (drawTrains) {
-			std::lock_guard<std::mutex> trainsLock(trainsMutex);
-			for (int i = 0; i < VALID_TRAINS; i++) {
-				float newRadius = TRAIN_MIN_SIZE + trains[i].capacity / TRAIN_CAPACITY_FLOAT * (TRAIN_SIZE_DIFF);
-				trains[i].updateRadius(newRadius);
-				sf::Vector2f trainPosition = trains[i].getPosition();
-				sf::Vector2f trainPositionNormalized = trainPosition - sf::Vector2f(newRadius, newRadius);
-				sf::Color trainColor = trains[i].getFillColor();
-				for (int j = 0; j < TRAIN_N_POINTS; j++) {
-					int idx = i * TRAIN_N_POINTS * 3 + j * 3;
-					trainVertices[idx] = sf::Vertex(trains[i].getPoint(j) + trainPositionNormalized, trainColor);
-					trainVertices[idx+1] = sf::Vertex(trainPosition, trainColor);
-					trainVertices[idx+2] = sf::Vertex(trains[i].getPoint((j + 1) % TRAIN_N_POINTS) + trainPositionNormalized, trainColor);
-				}
-			}
+	// compact copy of the station graph for the search engines
+	pathGraph.build();
 
-			window.draw(trainVertices);
+	#if USE_ROUTE_TABLE == true
+	// map precomputed routes, or solve all pairs again if the network has changed since they were written
+	if (RouteTable::fits()) {
+		uint64_t networkChecksum = RouteTable::networkChecksum();
+		if (!routes.load(ROUTE_TABLE_FILE, networkChecksum)) {
+			std::cout << "Route table missing or stale, solving all station pairs" << std::endl;
+			routes.build(ROUTE_TABLE_FILE, networkChecksum);
 		}
+		std::cout << "Loaded route table (" << routes.numLegs() << " legs)" << std::endl;
+	}
+	else {
+		std::cout << "Skipping route table for " << VALID_NODES << " nodes and " << VALID_LINES << " lines (max " << ROUTE_TABLE_MAX_NODES << " nodes, 16 bit line and stop indices)" << std::endl;
+	}
+	#endif
 
-		if (drawNodes) {
-			for (int i = 0; i < VALID_NODES; i++) {
-				float newRadius = NODE_MIN_SIZE + std::min(NODE_CAPACITY, nodes[i].capacity) / NODE_CAPACITY_FLOAT * (NODE_SIZE_DIFF);
-				nodes[i].updateRadius(newRadius);
-				sf::Vector2f nodePosition = nodes[i].getPosition();
-				sf::Vector2f nodePositionNormalized = nodePosition - sf::Vector2f(newRadius, newRadius);
-				sf::Color nodeColor = nodes[i].getFillColor();
-				for (int j = 0; j < NODE_N_POINTS; j++) {
-					int idx = i * NODE_N_POINTS * 3 + j * 3;
-					nodeVertices[idx] = sf::Vertex(nodes[i].getPoint(j) + nodePositionNormalized, nodeColor);
-					nodeVertices[idx+1] = sf::Vertex(nodePosition, nodeColor);
-					nodeVertices[idx+2] = sf::Vertex(nodes[i].getPoint((j + 1) % NODE_N_POINTS) + nodePositionNormalized, nodeColor);
-				}
-			}
+	// the contraction hierarchy and landmark tables are only built for the engine that runs, switching to another builds it on first use
+	if (!routes.loaded()) prepareEngine(DEFAULT_PATHFINDING_ENGINE);
 
-			window.draw(nodeVertices);
-		}
+	// enable continuous citizen spawning by default (necessary to generate initial citizen batch)
+	toggleSpawn = true;
 
-		if (drawLines) {
-			if (userNodesSelected == 2) {
-				window.draw(userPathVertexBuffer);
-			}
-			else {
-				window.draw(linesVertexBuffer);
-			}
-		}
+	// generate initial batch of citizens
+	generateRandomCitizens(CITIZEN_SPAWN_INIT);
+	std::cout << "Generated " << CITIZEN_SPAWN_INIT << " initial citizens" << std::endl;
 
-		window.setView(textView);
-		window.draw(text);
+	snapshots.resize(VALID_TRAINS, VALID_NODES);
 
-		window.display();
-	}
+	std::cout << "INIT DONE!" << std::endl << std::endl;
+	return AOK;
 }
 
 void pathfindingThread() {
 	std::unique_lock<std::mutex> pathsLock(pathsMutex);
 	while (!shouldExit) {
-		doPathfinding.wait(pathsLock, [] {return !justDidPathfinding || customSpawnCitizens || shouldExit; });
+		doPathfinding.wait(pathsLock, [] {return customSpawnCitizens || shouldExit; });
 		if (shouldExit) break;
 
 		// spawn citizens at user request
 		if (customSpawnCitizens) {
 			int spawned = 0;
 			for (int i = 0; i < CUSTOM_CITIZEN_SPAWN_AMT; i++) {
-				Node* end = &nodes[rand() % VALID_NODES];
+				Node* end = &nodes[std::uniform_int_distribution<int>(0, VALID_NODES - 1)(threadRng())];
 				if (nearestNode != end && citizens.add(nearestNode, end)) {
 					handledCitizens++;
 					spawned++;
@@ -860,23 +856,29 @@ void pathfindingThread() {
 			customSpawnCitizens = false;
 			doCustomCitizenSpawn.notify_one();
 		}
-		// spawn citizens using weighted-random node selection if spawning is enabled
-		else if (toggleSpawn) {
-			justDidPathfinding = true;
-
-			#if CITIZEN_SPAWN_METHOD == 1
-			// spawn a constant amount of citizens CITIZEN_SPAWN_AMT
-			generateRandomCitizens(CITIZEN_SPAWN_AMT);
-			#else
-			// spawn citizens up to a target amount TARGET_CITIZEN_COUNT
-			generateRandomCitizens(TARGET_CITIZEN_COUNT - citizens.activeSize());
-			#endif
-		}
 	}
 
 	std::cout << "Pathfinding thread shut down" << std::endl;
 }
 
+// copies what observers read at the tick boundary, the renderer never touches live simulation state
+static void publishSnapshot() {
+	SimSnapshot& snapshot = snapshots.back();
+	snapshot.tick = simTick;
+	snapshot.activeCitizens = citizens.activeSize();
+	snapshot.simSpeed = simSpeedStat.empty() ? 0 : simSpeedStat.back();
+	snapshot.touchedCitizens = touchedCitizensStat.empty() ? 0 : touchedCitizensStat.back();
+	snapshot.workerIdle = workerIdleStat.empty() ? 0 : workerIdleStat.back();
+	for (int i = 0; i < VALID_TRAINS; i++) {
+		snapshot.trainPositions[i] = trains[i].getPosition();
+		snapshot.trainLoads[i] = trains[i].capacity;
+	}
+	for (int i = 0; i < VALID_NODES; i++) {
+		snapshot.nodeLoads[i] = nodes[i].capacity;
+	}
+	snapshots.publish();
+}
+
 void simulationThread() {
 	simPause = false;
 
@@ -885,16 +887,27 @@ void simulationThread() {
 	activeCitizensStat.reserve(BENCHMARK_RESERVE);
 	clockStat.reserve(BENCHMARK_RESERVE);
 	simSpeedStat.reserve(BENCHMARK_RESERVE);
+	touchedCitizensStat.reserve(BENCHMARK_RESERVE);
+	workerIdleStat.reserve(BENCHMARK_RESERVE);
+	workerImbalanceStat.reserve(BENCHMARK_RESERVE);
+	clockStat.push_back(timeElapsed);
 
-	CitizenThreadPool pool(NUM_CITIZEN_WORKER_THREADS);
+	TickExecutor executor(CITIZEN_WORKER_THREADS);
+	Spawner spawner(&ridershipSampler, SPAWNER_THREADS);
+	unsigned long spawnCredit = 0;
+	citizenArrivals.resize(executor.size());
 
-	std::cout << "Initializing " << NUM_CITIZEN_WORKER_THREADS << " threads for citizen processing" << std::endl;
+	std::cout << "Initializing " << executor.size() << " threads for citizen processing, " << spawner.size() << " for citizen spawning" << std::endl;
 	
 	std::mutex simMutex;
 	std::unique_lock<std::mutex> simLock(simMutex);
 	while (!shouldExit) {
-		// wait if paused
-		doSimulation.wait(simLock, [] { return !simPause; } );
+		// wait if paused (debug reports are still printed)
+		doSimulation.wait(simLock, [] { return !simPause || debugReportRequested; } );
+		if (debugReportRequested.exchange(false)) {
+			debugReport();
+		}
+		if (simPause) continue;
 		simTick++;
 
 		#if BENCHMARK_MODE == true
@@ -914,53 +927,94 @@ void simulationThread() {
 			clockStat.push_back(double(clock()));
 			size_t clockSize = clockStat.size();
 			simSpeedStat.push_back(STAT_RATE / ((clockStat[clockSize-1] - clockStat[clockSize-2]) / CLOCKS_PER_SEC));
+			touchedCitizensStat.push_back(touchedCitizens / STAT_RATE);
+			touchedCitizens = 0;
+			workerIdleStat.push_back(float(executor.averageIdle()));
+			workerImbalanceStat.push_back(float(executor.averageImbalance()));
+			executor.resetStats();
 		}
 		
-		// ping pathfinding thread to spawn citizens
-		if (simTick % CITIZEN_SPAWN_FREQ == 0 && toggleSpawn) {
-			justDidPathfinding = false;
-			doPathfinding.notify_one();
+		// admit citizens whose paths the spawner has already solved
+		if (toggleSpawn) {
+			#if CITIZEN_SPAWN_METHOD == 1
+			// spawn a constant amount of citizens CITIZEN_SPAWN_AMT
+			if (simTick % CITIZEN_SPAWN_FREQ == 0) spawnCredit += CITIZEN_SPAWN_AMT;
+			#else
+			// spawn citizens up to a target amount TARGET_CITIZEN_COUNT
+			spawnCredit = TARGET_CITIZEN_COUNT > citizens.activeSize() ? TARGET_CITIZEN_COUNT - citizens.activeSize() : 0;
+			#endif
+			size_t room = citizens.max() - std::min(citizens.activeSize(), citizens.max());
+			size_t admitted = spawner.take(std::min<size_t>({ spawnCredit, room, (size_t)CITIZEN_ADMIT_PER_TICK }), [](PathHandle path) {
+				if (citizens.admit(path)) handledCitizens++;
+			});
+			spawnCredit -= admitted;
 		}
 
 		// run simulation on trains and citizens
-		{
-			std::lock_guard<std::mutex> trainsLock(trainsMutex);
-			for (int i = 0; i < VALID_TRAINS; i++) {
-				trains[i].updatePositionAlongLine();
-			}
+		for (int i = 0; i < VALID_TRAINS; i++) {
+			trains[i].updatePositionAlongLine();
 		}
 
+		// only citizens due this tick are touched, waiting and riding citizens are woken by trains
 		{
-			size_t chunkSize = citizens.activeSize() / NUM_CITIZEN_WORKER_THREADS + 1;
-			for (int i = 0; i < NUM_CITIZEN_WORKER_THREADS; i++) {
-				pool.enqueue([i, chunkSize]() {
-					std::vector<int> toDelete;
-					size_t start = i * chunkSize;
-					size_t end = std::min(start + chunkSize, citizens.activeSize());
-					bool doCull = simTick % CITIZEN_CULL_FREQ == 0;
-					for (size_t ind = start; ind < end; ind++) {
-						Citizen& cit = citizens[ind];
-						if (!cit.status == STATUS_DESPAWNED) {
-							if (cit.updatePositionAlongPath()) {
-								toDelete.push_back(ind);
-							}
-							else if (doCull && cit.cull()) {
-								std::cout << "Scheduled deletion for timed out citizen" << std::endl; // this never prints, but for some reason, it needs to be here. lol
-								toDelete.push_back(ind);
-							}
-						}
+			std::vector<unsigned int>& due = citizenWheel.advance(simTick);
+			touchedCitizens += due.size();
+			citizenOutcomes.resize(due.size());
+			auto update = [&due](size_t begin, size_t end, unsigned int worker) {
+				for (size_t ind = begin; ind < end; ind++) {
+					unsigned int id = due[ind];
+					#if CITIZEN_VERIFY_MODE == true
+					if (citizenUpdateTicks[id].exchange(simTick) == simTick) doubleUpdates++;
+					#endif
+					if (citizens.update(id, citizenArrivals[worker])) {
+						citizens.despawn(id);
+						citizenOutcomes[ind] = CITIZEN_OUTCOME_DESPAWNED;
 					}
-					{
-						std::lock_guard<std::mutex> citizenLock(blockStack);
-						for (int& i : toDelete) {
-							citizens.remove(i);
-						}
+					else {
+						citizenOutcomes[ind] = citizens.wakeDelay(id);
 					}
-				});
+				}
+			};
+			executor.parallelFor(due.size(), update);
+
+			// in due order, so the result doesn't depend on how the batch was split between workers
+			for (size_t ind = 0; ind < due.size(); ind++) {
+				unsigned int id = due[ind];
+				unsigned int outcome = citizenOutcomes[ind];
+				if (outcome == CITIZEN_OUTCOME_DESPAWNED) {
+					citizenDespawns.push_back(id);
+				}
+				else if (outcome > 0) {
+					citizenWheel.schedule(id, simTick + outcome);
+				}
+				else {
+					citizens.enterPlatform(id);
+				}
+			}
+			for (NodeArrivals& arrivals : citizenArrivals) {
+				arrivals.apply();
 			}
+			despawnedCitizens += citizenDespawns.size();
+			citizens.compact(citizenDespawns);
+		}
+		if (simTick % CITIZEN_CULL_FREQ == 0) {
+			cullCitizens();
+		}
 
-			pool.waitForCompletion();
+		#if DETERMINISTIC_MODE == true
+		stateHash = hashState(stateHash);
+		if (simTick % STAT_RATE == 0) {
+			std::cout << std::endl << "State hash at tick " << simTick << ": " << std::hex << stateHash << std::dec << std::endl;
 		}
+		#endif
+
+		#if CITIZEN_VERIFY_MODE == true
+		if (simTick % CITIZEN_VERIFY_RATE == 0) {
+			verifyCitizens();
+		}
+		#endif
+
+		publishSnapshot();
 	}
 
 	std::cout << "Simulation thread shut down" << std::endl;
@@ -974,7 +1028,24 @@ void simulationThread() {
 	for (int i : activeCitizensStat) averageActiveCitizens += i;
 	averageActiveCitizens /= activeCitizensStat.size();
 	std::cout << "Averaged " << averageActiveCitizens << " concurrent citizen agents" << std::endl;
-	std::cout << "Handled total " << handledCitizens << " citizen agents" << std::endl;
+	long int averageTouchedCitizens = 0;
+	for (int i : touchedCitizensStat) averageTouchedCitizens += i;
+	averageTouchedCitizens /= touchedCitizensStat.size();
+	std::cout << "Averaged " << averageTouchedCitizens << " citizen agents touched per tick" << std::endl;
+	float averageIdle = 0, averageImbalance = 0;
+	for (float f : workerIdleStat) averageIdle += f;
+	for (float f : workerImbalanceStat) averageImbalance += f;
+	averageIdle /= workerIdleStat.size();
+	averageImbalance /= workerImbalanceStat.size();
+	std::cout << "Averaged " << averageIdle * 100 << "% worker idle time, " << averageImbalance << "x worker imbalance (" << executor.size() << " threads)" << std::endl;
+	std::cout << "Handled total " << handledCitizens << " citizen agents, " << despawnedCitizens << " despawned" << std::endl;
+	#if DETERMINISTIC_MODE == true
+	std::cout << "Final state hash: " << std::hex << stateHash << std::dec << std::endl;
+	#endif
+	std::cout << "Spawner solved " << spawner.solved() << " paths on " << spawner.size() << " threads, " << spawner.ready() << " left waiting" << std::endl;
+	#if CITIZEN_VERIFY_MODE == true
+	std::cout << "Verified " << verifiedCitizens << " live citizens over " << verifyChecks << " checks: " << verifyErrors << " lost, tracked twice or miscounted, " << doubleUpdates << " updated twice in a tick" << std::endl;
+	#endif
 
 	doPathfinding.notify_one();
 }
@@ -989,6 +1060,20 @@ int main() {
 		return initStatus;
 	}
 
+	#if PATHFINDING_BENCHMARK_MODE == true
+	pathfindingBenchmark();
+	return AOK;
+	#endif
+
+	#if CH_VALIDATION_MODE == true
+	contractionValidation();
+	return AOK;
+	#endif
+
+	#if NETWORK_COMPILE_MODE == true
+	return AOK;
+	#endif
+
 	// initialize threads
 	std::thread renThread;
 	#if BENCHMARK_MODE == true
@@ -1001,9 +1086,11 @@ int main() {
 	std::cout << TARGET_CITIZEN_COUNT << "-N/";
 	#endif
 	std::cout << CITIZEN_SPAWN_FREQ << " ticks, max " << MAX_CITIZENS << std::endl;
-	#else
+	#elif RENDER_MODE == true
 	// enable rendering
 	renThread = std::thread(renderingThread);
+	#else
+	std::cout << "Simulation running headless" << std::endl;
 	#endif
 
 	#if DISABLE_SIMULATION == false
@@ -1012,7 +1099,7 @@ int main() {
 	#endif
 
 	// exit
-	if (!BENCHMARK_MODE && renThread.joinable()) {
+	if (renThread.joinable()) {
 		renThread.join();
 	}
 	#if DISABLE_SIMULATION == false
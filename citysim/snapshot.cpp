@@ -0,0 +1,34 @@
+#include "snapshot.h"
+
+SnapshotBuffer::SnapshotBuffer() {
+	backInd = 0;
+	middle = 1;
+	frontInd = 2;
+	for (SimSnapshot& snapshot : buffers) {
+		snapshot.tick = 0;
+		snapshot.activeCitizens = 0;
+		snapshot.simSpeed = 0;
+		snapshot.touchedCitizens = 0;
+		snapshot.workerIdle = 0;
+	}
+}
+
+void SnapshotBuffer::resize(size_t numTrains, size_t numNodes) {
+	for (SimSnapshot& snapshot : buffers) {
+		snapshot.trainPositions.resize(numTrains);
+		snapshot.trainLoads.resize(numTrains);
+		snapshot.nodeLoads.resize(numNodes);
+	}
+}
+
+void SnapshotBuffer::publish() {
+	// release makes the filled buffer visible to the reader that picks it up
+	backInd = middle.exchange(backInd | SNAPSHOT_FRESH, std::memory_order_acq_rel) & ~SNAPSHOT_FRESH;
+}
+
+const SimSnapshot& SnapshotBuffer::acquire() {
+	if (middle.load(std::memory_order_relaxed) & SNAPSHOT_FRESH) {
+		frontInd = middle.exchange(frontInd, std::memory_order_acq_rel) & ~SNAPSHOT_FRESH;
+	}
+	return buffers[frontInd];
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "macros.h"
+#include "geometry.h"
+
+// simulation state published once per tick for observers (the renderer), indices match the trains and nodes arrays
+struct SimSnapshot {
+	unsigned long tick;
+	size_t activeCitizens;
+	int simSpeed; // latest STAT_RATE averages
+	int touchedCitizens;
+	float workerIdle;
+	std::vector<Vec2> trainPositions;
+	std::vector<unsigned int> trainLoads;
+	std::vector<unsigned int> nodeLoads;
+};
+
+// triple buffer between the simulation thread (single writer) and one reader
+// the writer fills back() and swaps it with the middle buffer on publish(), the reader swaps its front buffer with the middle one if it is newer
+// neither side ever waits for the other, a slow reader just skips snapshots
+class SnapshotBuffer {
+public:
+	SnapshotBuffer();
+
+	// sizes every buffer, call before either thread starts
+	void resize(size_t numTrains, size_t numNodes);
+
+	// writer only
+	inline SimSnapshot& back() {
+		return buffers[backInd];
+	}
+	void publish();
+
+	// reader only, stays valid until the next acquire()
+	const SimSnapshot& acquire();
+
+private:
+	SimSnapshot buffers[3];
+	std::atomic<unsigned int> middle; // buffer index, SNAPSHOT_FRESH is set while the reader hasn't taken it
+	unsigned int backInd;
+	unsigned int frontInd;
+};
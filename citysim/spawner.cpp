@@ -0,0 +1,112 @@
+#include <algorithm>
+#include "patharena.h"
+#include "spawner.h"
+
+extern PathArena paths;
+
+Spawner::Spawner(RidershipSampler* trips, unsigned int threads) {
+	sampler = trips;
+	incoming = nullptr;
+	nextSeq = 0;
+	expectedSeq = 0;
+	readyCount = 0;
+	solvedCount = 0;
+	stop = false;
+	current = nullptr;
+	currentPos = 0;
+
+	unsigned int numThreads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned int i = 0; i < numThreads; i++) {
+		producers.emplace_back([this] { producerThread(); });
+	}
+}
+
+Spawner::~Spawner() {
+	{
+		std::lock_guard<std::mutex> capLock(capMutex);
+		stop = true;
+	}
+	capCV.notify_all();
+	for (std::thread& producer : producers) {
+		producer.join();
+	}
+
+	// paths that never got admitted still hold references
+	if (current != nullptr) {
+		for (int i = currentPos; i < current->count; i++) {
+			paths.release(current->paths[i]);
+		}
+		delete current;
+	}
+	ReadyBatch* batch = incoming.exchange(nullptr);
+	while (batch != nullptr) {
+		queued.push(batch);
+		batch = batch->next;
+	}
+	while (!queued.empty()) {
+		batch = queued.top();
+		queued.pop();
+		for (int i = 0; i < batch->count; i++) {
+			paths.release(batch->paths[i]);
+		}
+		delete batch;
+	}
+}
+
+ReadyBatch* Spawner::nextBatch() {
+	while (true) {
+		ReadyBatch* batch = incoming.exchange(nullptr, std::memory_order_acquire);
+		while (batch != nullptr) {
+			ReadyBatch* next = batch->next;
+			queued.push(batch);
+			batch = next;
+		}
+
+		#if DETERMINISTIC_MODE == true
+		// every claimed seq gets delivered, and producers never block on the cap while expectedSeq is outstanding
+		bool ready = !queued.empty() && queued.top()->seq == expectedSeq;
+		if (!ready && !producers.empty()) {
+			std::this_thread::yield();
+			continue;
+		}
+		#else
+		bool ready = !queued.empty();
+		#endif
+		if (!ready) {
+			return nullptr;
+		}
+		ReadyBatch* next = queued.top();
+		queued.pop();
+		expectedSeq = next->seq + 1;
+		return next;
+	}
+}
+
+void Spawner::producerThread() {
+	Trip trips[CITIZEN_SPAWN_BATCH];
+	while (true) {
+		{
+			std::unique_lock<std::mutex> capLock(capMutex);
+			capCV.wait(capLock, [this] { return stop || readyCount < SPAWNER_READY_CAP; });
+			if (stop) return;
+		}
+
+		ReadyBatch* batch = new ReadyBatch();
+		batch->count = 0;
+		batch->seq = nextSeq++;
+		CounterRng rng(spawnSeed(), batch->seq);
+		sampler->sampleTrips(trips, CITIZEN_SPAWN_BATCH, rng);
+		for (int i = 0; i < CITIZEN_SPAWN_BATCH; i++) {
+			PathHandle path = trips[i].start->findPath(trips[i].end);
+			if (path != NULL_PATH) {
+				batch->paths[batch->count++] = path;
+			}
+		}
+		solvedCount += batch->count;
+
+		// counted before the push, so take() can never see more paths than readyCount
+		readyCount += batch->count;
+		batch->next = incoming.load(std::memory_order_relaxed);
+		while (!incoming.compare_exchange_weak(batch->next, batch, std::memory_order_release, std::memory_order_relaxed));
+	}
+}
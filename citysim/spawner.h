@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <queue>
+#include <vector>
+#include "macros.h"
+#include "node.h"
+#include "sampler.h"
+
+// solved paths for citizens that have yet to be admitted, producers hand them over a batch at a time
+struct ReadyBatch {
+	PathHandle paths[CITIZEN_SPAWN_BATCH];
+	int count;
+	unsigned long seq; // batches are sampled from stream seq, and admitted in seq order
+	ReadyBatch* next;
+};
+
+// producer threads sample trips and solve their paths ahead of time, so the simulation never waits on pathfinding
+// batches go onto a lock-free list that only the simulation thread takes from (see take())
+// producers stop once SPAWNER_READY_CAP paths are waiting and resume as they get admitted
+// batch n always holds the same trips, so in DETERMINISTIC_MODE take() waits for the next batch in sequence instead of skipping ahead
+class Spawner {
+public:
+	// 0 threads uses std::thread::hardware_concurrency()
+	Spawner(RidershipSampler* trips, unsigned int threads = 0);
+	~Spawner();
+
+	inline unsigned int size() {
+		return (unsigned int)producers.size();
+	}
+	inline size_t ready() {
+		return readyCount.load(std::memory_order_relaxed);
+	}
+	inline unsigned long solved() {
+		return solvedCount.load(std::memory_order_relaxed);
+	}
+
+	// simulation thread only, passes up to max ready paths (oldest batches first) to admit(path)
+	template<class F>
+	size_t take(size_t max, F admit) {
+		size_t n = 0;
+		while (n < max) {
+			if (current == nullptr || currentPos == current->count) {
+				delete current;
+				current = nextBatch();
+				currentPos = 0;
+				if (current == nullptr) break;
+				continue;
+			}
+			admit(current->paths[currentPos++]);
+			n++;
+		}
+		if (n > 0) {
+			// producers wait for the ready count to drop back under the cap
+			size_t before = readyCount.fetch_sub(n);
+			if (before >= SPAWNER_READY_CAP && before - n < SPAWNER_READY_CAP) {
+				std::lock_guard<std::mutex> capLock(capMutex);
+				capCV.notify_all();
+			}
+		}
+		return n;
+	}
+private:
+	RidershipSampler* sampler;
+	std::vector<std::thread> producers;
+	std::atomic<ReadyBatch*> incoming; // newest first
+	std::atomic<unsigned long> nextSeq;
+	std::atomic<size_t> readyCount;
+	std::atomic<unsigned long> solvedCount;
+	bool stop;
+	std::mutex capMutex;
+	std::condition_variable capCV;
+
+	// consumer side
+	struct LaterSeq {
+		bool operator()(const ReadyBatch* a, const ReadyBatch* b) const {
+			return a->seq > b->seq;
+		}
+	};
+	ReadyBatch* current;
+	int currentPos;
+	unsigned long expectedSeq;
+	std::priority_queue<ReadyBatch*, std::vector<ReadyBatch*>, LaterSeq> queued; // taken from incoming, lowest seq first
+
+	// returns nullptr if no batch is ready, in DETERMINISTIC_MODE waits for the next one in sequence while producers are running
+	ReadyBatch* nextBatch();
+	void producerThread();
+};
@@ -0,0 +1,60 @@
+#include "timerwheel.h"
+
+TimerWheel::TimerWheel() {
+	current = 0;
+	numEntries = 0;
+}
+
+void TimerWheel::schedule(unsigned int citizen, unsigned long tick) {
+	unsigned long delta = tick - current;
+	int level = 0;
+	while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ul << (TIMER_WHEEL_BITS * (level + 1)))) {
+		level++;
+	}
+	// anything further out than the top level waits in its last slot and is rescheduled when it comes up
+	unsigned long maxDelta = (1ul << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+	unsigned long slotTick = delta > maxDelta ? current + maxDelta : tick;
+	int slot = (slotTick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+	slots[level][slot].push_back(TimerEntry{ citizen, tick });
+	numEntries++;
+}
+
+void TimerWheel::scheduleLater(unsigned int citizen) {
+	std::lock_guard<std::mutex> lock(pendingLock);
+	pending.push_back(citizen);
+}
+
+void TimerWheel::cascade(int level) {
+	int slot = (current >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+	std::vector<TimerEntry> entries;
+	entries.swap(slots[level][slot]);
+	numEntries -= entries.size();
+	for (TimerEntry& e : entries) {
+		if (e.tick <= current) {
+			due.push_back(e.citizen);
+		}
+		else {
+			schedule(e.citizen, e.tick);
+		}
+	}
+}
+
+std::vector<unsigned int>& TimerWheel::advance(unsigned long tick) {
+	current = tick;
+	due.clear();
+
+	// higher levels first, so their entries can land in the slot that is due now
+	for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+		if ((current & ((1ul << (TIMER_WHEEL_BITS * level)) - 1)) == 0) {
+			cascade(level);
+		}
+	}
+	cascade(0);
+
+	{
+		std::lock_guard<std::mutex> lock(pendingLock);
+		due.insert(due.end(), pending.begin(), pending.end());
+		pending.clear();
+	}
+	return due;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include "macros.h"
+
+struct TimerEntry {
+	unsigned int citizen;
+	unsigned long tick;
+};
+
+// hierarchical timer wheel of citizen indices, woken on the tick they are due
+// level l has TIMER_WHEEL_SLOTS slots of TIMER_WHEEL_SLOTS^l ticks each, entries cascade down a level when their slot comes up
+// schedule() is only called from the simulation thread (between worker batches), other threads use scheduleLater()
+class TimerWheel {
+public:
+	TimerWheel();
+
+	inline unsigned long now() {
+		return current;
+	}
+	inline size_t size() {
+		return numEntries;
+	}
+
+	// tick must be after now()
+	void schedule(unsigned int citizen, unsigned long tick);
+	// thread-safe, the citizen is woken on the next call to advance()
+	void scheduleLater(unsigned int citizen);
+
+	// moves to tick (now() + 1) and returns the citizens due on it
+	std::vector<unsigned int>& advance(unsigned long tick);
+
+	// calls fn(citizen) for every scheduled citizen, including ones waiting for the next advance()
+	template<class F>
+	void forEach(F fn) {
+		for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+			for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+				for (TimerEntry& e : slots[level][slot]) {
+					fn(e.citizen);
+				}
+			}
+		}
+		std::lock_guard<std::mutex> lock(pendingLock);
+		for (unsigned int citizen : pending) {
+			fn(citizen);
+		}
+	}
+private:
+	std::vector<TimerEntry> slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	std::vector<unsigned int> due;
+	unsigned long current;
+	size_t numEntries;
+
+	std::mutex pendingLock;
+	std::vector<unsigned int> pending;
+
+	void cascade(int level);
+};
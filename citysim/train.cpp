@@ -1,8 +1,18 @@
 #include "train.h"
+#include "citizen.h"
+
+extern CitizenVector citizens;
 
 // aah, this whole class is so confusing! why did i do this?
 Train::Train() {
-	 Drawable(TRAIN_MIN_SIZE, TRAIN_N_POINTS);
+	status = STATUS_DESPAWNED;
+	statusForward = STATUS_FORWARD;
+	index = 0;
+	nextIndex = 0;
+	capacity = 0;
+	timer = 0;
+	dist = 0;
+	line = nullptr;
 }
 
 Node* Train::getLastStop() {
@@ -45,6 +55,32 @@ int Train::getCorrectNextIndex() {
 	}
 }
 
+int Train::departingDirection() {
+	if (index == line->size - 1) return PLATFORM_BACKWARD;
+	if (index == 0) return PLATFORM_FORWARD;
+	return statusForward == STATUS_FORWARD ? PLATFORM_FORWARD : PLATFORM_BACKWARD;
+}
+
+void Train::alightRiders() {
+	std::vector<unsigned int>& alighting = riders[index];
+	for (unsigned int c : alighting) {
+		citizens.alight(c);
+		citizenWheel.schedule(c, citizenWheel.now() + 1);
+	}
+	capacity -= (unsigned int)alighting.size();
+	alighting.clear();
+}
+
+void Train::boardRiders() {
+	PlatformQueue& platform = platformQueue(line, index, departingDirection());
+	while (capacity < TRAIN_CAPACITY && !platform.empty()) {
+		PlatformRider rider = platform.pop();
+		citizens.board(rider.citizen, this);
+		riders[rider.alightInd].push_back(rider.citizen);
+		capacity++;
+	}
+}
+
 void Train::updatePositionAlongLine() {
 	timer += TRAIN_SPEED;
 
@@ -76,6 +112,7 @@ void Train::updatePositionAlongLine() {
 				index = nextIndex;
 				timer = 0;
 				status = STATUS_AT_STOP;
+				alightRiders();
 			}
 			#if TRAIN_ERRORS == true
 			else {
@@ -85,6 +122,8 @@ void Train::updatePositionAlongLine() {
 		}
 		break;
 	case STATUS_AT_STOP:
+		boardRiders();
+
 		// done boarding/deboarding
 		if (timer > TRAIN_STOP_THRESH) {
 			if (getLastStop()->removeTrain(this)) {
@@ -1,31 +1,32 @@
 #pragma once
 
-#include <SFML/Graphics.hpp>
 #include <iostream>
-#include "drawable.h"
+#include "geometry.h"
 #include "macros.h"
 #include "line.h"
 #include "node.h"
+#include "platform.h"
 class Node;
 
-class Train : public Drawable {
+class Train : public Positioned {
 public:
 	Train();
 
 	char status;
 	char statusForward;
-	char index;
-	char nextIndex;
-	unsigned int capacity;
+	int index;
+	int nextIndex;
+	unsigned int capacity; // riders on board, only changed by boarding and alighting
 	float timer;
 	float dist;
 	Line* line;
+	std::vector<std::vector<unsigned int>> riders; // citizens on board, by the stop index where their leg ends (one list per stop of line)
 
-	inline float getDist(char indx) {
+	inline float getDist(int indx) {
 		return line->dist[indx];
 	}
 
-	inline Node* getStop(char indx) {
+	inline Node* getStop(int indx) {
 		return line->path[indx];
 	}
 	Node* getLastStop();
@@ -36,5 +37,12 @@ public:
 	int getPrevIndex();
 	int getCorrectNextIndex();
 
+	// direction the train leaves its current stop in (PLATFORM_FORWARD or PLATFORM_BACKWARD)
+	int departingDirection();
+	// lets off riders whose leg ends at the current stop
+	void alightRiders();
+	// boards waiting riders until the train is full
+	void boardRiders();
+
 	void updatePositionAlongLine();
 };
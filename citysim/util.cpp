@@ -1,15 +1,34 @@
+#include <fstream>
 #include "util.h"
+#include "line.h"
 
-// utility function to parse hex string into sf::Color
+// utility function to parse hex string into LineColor
 // requires 6 character string
-void util::colorConvert(sf::Color* v, const std::string& a) {
+void util::colorConvert(LineColor* v, const std::string& a) {
 	v->r = std::stoi(a.substr(0, 2), nullptr, 16);
 	v->g = std::stoi(a.substr(2, 2), nullptr, 16);
 	v->b = std::stoi(a.substr(4, 2), nullptr, 16);
 	v->a = 255;
 }
 
-// utility function to update capacity of node/train by -1 without uint overflow
-void util::subCapacity(unsigned int* ptr) {
-	*ptr = std::min(*ptr - 1, 0u);
+// utility function to fold bytes into a 64 bit FNV-1a hash
+uint64_t util::hashBytes(const void* data, size_t size, uint64_t hash) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// utility function to fold the contents of a file into a 64 bit FNV-1a hash
+// returns false if the file could not be read
+bool util::hashFile(const char* path, uint64_t* hash) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+	char buffer[4096];
+	while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+		*hash = hashBytes(buffer, (size_t)file.gcount(), *hash);
+	}
+	return true;
 }
\ No newline at end of file
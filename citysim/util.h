@@ -1,12 +1,19 @@
 #pragma once
 
-#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <string>
+
+struct LineColor;
 
 namespace util {
-	// utility function to parse hex string into sf::Color
+	// utility function to parse hex string into LineColor
 	// requires 6 character string
-	void colorConvert(sf::Color* v, const std::string& a);
+	void colorConvert(LineColor* v, const std::string& a);
+
+	// utility function to fold bytes into a 64 bit FNV-1a hash
+	uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
 
-	// utility function to update capacity of node/train by -1 without uint overflow
-	void subCapacity(unsigned int* ptr);
+	// utility function to fold the contents of a file into a 64 bit FNV-1a hash
+	// returns false if the file could not be read
+	bool hashFile(const char* path, uint64_t* hash);
 }
\ No newline at end of file